@@ -47,6 +47,7 @@ JLCXX_MODULE define_julia_module(jlcxx::Module &pi) {
     pi.add_bits<method_t>("method_t");
     pi.set_const("NUMEROV", NUMEROV);
     pi.set_const("WHITTAKER", WHITTAKER);
+    pi.set_const("SEMICLASSICAL", SEMICLASSICAL);
 
     pi.add_bits<parity_t>("parity_t");
     pi.set_const("NA", NA);
@@ -55,6 +56,28 @@ JLCXX_MODULE define_julia_module(jlcxx::Module &pi) {
 
     pi.set_const("ARB", ARB);
 
+    pi.add_type<CacheTableStatistics>("CacheTableStatistics")
+        .method("hits", [](CacheTableStatistics &s) { return s.hits; })
+        .method("misses", [](CacheTableStatistics &s) { return s.misses; })
+        .method("store_hits", [](CacheTableStatistics &s) { return s.store_hits; })
+        .method("database_hits", [](CacheTableStatistics &s) { return s.database_hits; })
+        .method("calculations", [](CacheTableStatistics &s) { return s.calculations; })
+        .method("store_seconds", [](CacheTableStatistics &s) { return s.store_seconds; })
+        .method("database_seconds", [](CacheTableStatistics &s) { return s.database_seconds; })
+        .method("calculation_seconds",
+                [](CacheTableStatistics &s) { return s.calculation_seconds; });
+
+    pi.add_type<MatrixElementCacheStatistics>("MatrixElementCacheStatistics")
+        .method("radial", [](MatrixElementCacheStatistics &s) { return s.radial; })
+        .method("wavefunction", [](MatrixElementCacheStatistics &s) { return s.wavefunction; })
+        .method("angular", [](MatrixElementCacheStatistics &s) { return s.angular; })
+        .method("reduced_commutes_s",
+                [](MatrixElementCacheStatistics &s) { return s.reduced_commutes_s; })
+        .method("reduced_commutes_l",
+                [](MatrixElementCacheStatistics &s) { return s.reduced_commutes_l; })
+        .method("reduced_multipole",
+                [](MatrixElementCacheStatistics &s) { return s.reduced_multipole; });
+
     pi.add_type<MatrixElementCache>("MatrixElementCache")
         .constructor<std::string>()
         .method("getElectricDipole", &MatrixElementCache::getElectricDipole)
@@ -122,8 +145,11 @@ JLCXX_MODULE define_julia_module(jlcxx::Module &pi) {
                 })
         .method("setDefectDB", &MatrixElementCache::setDefectDB)
         .method("setMethod", &MatrixElementCache::setMethod)
+        .method("setRadialTolerance", &MatrixElementCache::setRadialTolerance)
         .method("loadElectricDipoleDB", &MatrixElementCache::loadElectricDipoleDB)
-        .method("size", &MatrixElementCache::size);
+        .method("size", &MatrixElementCache::size)
+        .method("getStatistics", &MatrixElementCache::getStatistics)
+        .method("resetStatistics", &MatrixElementCache::resetStatistics);
 
     pi.add_type<StateOne>("StateOne")
         .constructor<std::string, int, int, float, float>()
@@ -0,0 +1,41 @@
+# Copyright (c) 2020 Sebastian Weber, Henri Menke, Alexander Papageorge. All rights reserved.
+#
+# This file is part of the pairinteraction library.
+#
+# The pairinteraction library is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# The pairinteraction library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+# TestCacheStatistics
+using Test
+using PairInteraction
+
+# setUp
+cache = PairInteraction.MatrixElementCache(mktempdir())
+s1 = PairInteraction.StateOne("Rb", 42, 0, 0.5f0, 0.5f0)
+s2 = PairInteraction.StateOne("Rb", 42, 1, 0.5f0, 0.5f0)
+
+# test_counters
+radial = PairInteraction.getRadial(cache, s1, s2, 1)
+@test PairInteraction.getRadial(cache, s1, s2, 1) == radial
+statistics = PairInteraction.radial(PairInteraction.getStatistics(cache))
+@test PairInteraction.hits(statistics) == 1
+@test PairInteraction.misses(statistics) == 1
+@test PairInteraction.calculations(statistics) == 1
+@test PairInteraction.calculation_seconds(statistics) > 0
+statistics = PairInteraction.wavefunction(PairInteraction.getStatistics(cache))
+@test PairInteraction.calculations(statistics) == 2
+
+# test_reset
+PairInteraction.resetStatistics(cache)
+statistics = PairInteraction.radial(PairInteraction.getStatistics(cache))
+@test PairInteraction.hits(statistics) == 0
+@test PairInteraction.calculations(statistics) == 0
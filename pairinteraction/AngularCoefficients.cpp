@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AngularCoefficients.hpp"
+
+#include <wignerSymbols/wignerSymbols-cpp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////
+/// Tables /////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+template <size_t N>
+size_t AngularCoefficients::Table<N>::flatten(const std::array<size_t, N> &index,
+                                              const std::array<size_t, N> &shape) {
+    size_t flat = 0;
+    for (size_t d = 0; d < N; ++d) {
+        flat = flat * shape[d] + index[d];
+    }
+    return flat;
+}
+
+template <size_t N>
+template <typename F>
+const std::vector<double> &
+AngularCoefficients::Table<N>::getBlock(const std::array<size_t, N> &index, F &&calculate) {
+    auto inside = [&]() {
+        for (size_t d = 0; d < N; ++d) {
+            if (index[d] >= shape[d]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Return the block if it has already been calculated
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (inside() && blocks[flatten(index, shape)]) {
+            CacheTableCounters::add(counters.local().hits);
+            return *blocks[flatten(index, shape)];
+        }
+    }
+    CacheTableCounters::add(counters.local().misses);
+
+    // Calculate the block without holding the lock
+    std::unique_ptr<const std::vector<double>> block;
+    {
+        CacheTableTimer timer(counters.local().calculation_nanoseconds);
+        block = std::make_unique<const std::vector<double>>(calculate());
+    }
+    CacheTableCounters::add(counters.local().calculations);
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    // Enlarge the table so that it contains the block (the size is doubled to amortize the cost
+    // of rearranging the blocks)
+    if (!inside()) {
+        std::array<size_t, N> new_shape = shape;
+        size_t new_size = 1;
+        for (size_t d = 0; d < N; ++d) {
+            while (new_shape[d] <= index[d]) {
+                new_shape[d] = std::max<size_t>(1, 2 * new_shape[d]);
+            }
+            new_size *= new_shape[d];
+        }
+
+        std::vector<std::unique_ptr<const std::vector<double>>> new_blocks(new_size);
+        for (size_t flat = 0; flat < blocks.size(); ++flat) {
+            if (!blocks[flat]) {
+                continue;
+            }
+            std::array<size_t, N> old_index;
+            for (size_t d = N, remainder = flat; d-- > 0; remainder /= shape[d]) {
+                old_index[d] = remainder % shape[d];
+            }
+            new_blocks[flatten(old_index, new_shape)] = std::move(blocks[flat]);
+        }
+
+        shape = new_shape;
+        blocks = std::move(new_blocks);
+    }
+
+    // Store the block unless another thread was faster
+    auto &entry = blocks[flatten(index, shape)];
+    if (!entry) {
+        entry = std::move(block);
+    }
+    return *entry;
+}
+
+template <size_t N>
+size_t AngularCoefficients::Table<N>::memory() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    size_t bytes = blocks.capacity() * sizeof(blocks[0]);
+    for (auto const &block : blocks) {
+        if (block) {
+            bytes += sizeof(*block) + block->capacity() * sizeof(double);
+        }
+    }
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////
+/// Angular coefficients ///////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+size_t AngularCoefficients::memory() const {
+    return sizeof(*this) + table_angular.memory() + table_reduced_commutes_s.memory() +
+        table_reduced_commutes_l.memory() + table_reduced_multipole.memory();
+}
+
+AngularCoefficients::Statistics AngularCoefficients::getStatistics() const {
+    return {table_angular.counters.snapshot(), table_reduced_commutes_s.counters.snapshot(),
+            table_reduced_commutes_l.counters.snapshot(),
+            table_reduced_multipole.counters.snapshot()};
+}
+
+void AngularCoefficients::resetStatistics() {
+    table_angular.counters.reset();
+    table_reduced_commutes_s.counters.reset();
+    table_reduced_commutes_l.counters.reset();
+    table_reduced_multipole.counters.reset();
+}
+
+double AngularCoefficients::getAngular(int kappa, float j1, float j2, float m1, float m2) {
+    // Use the symmetry of the Wigner 3j symbol to store only elements with j1 <= j2
+    int sgn = 1;
+    if (!((j1 < j2) || ((j1 == j2) && (m1 <= m2)))) {
+        sgn = std::pow(-1, int(j1 - m1 + j2 - m2));
+        std::swap(j1, j2);
+        std::swap(m1, m2);
+    }
+
+    long twoj1 = std::lround(2 * j1);
+    long twoj2 = std::lround(2 * j2);
+    long idx1 = std::lround(j1 + m1);
+    long idx2 = std::lround(j2 + m2);
+    if (kappa < 0 || twoj1 < 0 || idx1 < 0 || idx1 > twoj1 || idx2 < 0 || idx2 > twoj2) {
+        return 0;
+    }
+
+    const auto &block = table_angular.getBlock(
+        {{size_t(kappa), size_t(twoj1), size_t(twoj2)}}, [&]() {
+            std::vector<double> values((twoj1 + 1) * (twoj2 + 1), 0);
+            for (long i1 = 0; i1 <= twoj1; ++i1) {
+                for (long i2 = 0; i2 <= twoj2; ++i2) {
+                    float j_row = twoj1 / 2.f;
+                    float j_col = twoj2 / 2.f;
+                    float m_row = i1 - j_row;
+                    float m_col = i2 - j_col;
+                    float q = m_row - m_col;
+                    // Check the selection rules
+                    if (std::abs(q) > kappa || j_col < std::abs(j_row - kappa) ||
+                        j_col > j_row + kappa) {
+                        continue;
+                    }
+                    values[i1 * (twoj2 + 1) + i2] = std::pow(-1, int(j_row - m_row)) *
+                        WignerSymbols::wigner3j(j_row, kappa, j_col, -m_row, q, m_col);
+                }
+            }
+            return values;
+        });
+
+    return sgn * block[idx1 * (twoj2 + 1) + idx2];
+}
+
+double AngularCoefficients::getReducedCommutesS(float s, int kappa, int l1, int l2, float j1,
+                                                float j2) {
+    // Use the symmetry of the Wigner 6j symbol to store only elements with l1 <= l2
+    int sgn = 1;
+    if (!((l1 < l2) || ((l1 == l2) && (j1 <= j2)))) {
+        sgn = std::pow(-1, int(l1 + j1 + l2 + j2 + 2 * s)); // TODO is this formula always correct?
+        std::swap(l1, l2);
+        std::swap(j1, j2);
+    }
+
+    // The coefficient vanishes unless j1 = |l1-s|, ..., l1+s and j2 = |l2-s|, ..., l2+s
+    long twos = std::lround(2 * s);
+    long offset1 = std::labs(2 * l1 - twos);
+    long offset2 = std::labs(2 * l2 - twos);
+    long size1 = std::min<long>(2 * l1, twos) + 1;
+    long size2 = std::min<long>(2 * l2, twos) + 1;
+    long idx1 = std::lround(2 * j1) - offset1;
+    long idx2 = std::lround(2 * j2) - offset2;
+    if (kappa < 0 || l1 < 0 || twos < 0 || idx1 < 0 || idx1 % 2 != 0 || idx1 / 2 >= size1 ||
+        idx2 < 0 || idx2 % 2 != 0 || idx2 / 2 >= size2) {
+        return 0;
+    }
+
+    const auto &block = table_reduced_commutes_s.getBlock(
+        {{size_t(twos), size_t(kappa), size_t(l1), size_t(l2)}}, [&]() {
+            std::vector<double> values(size1 * size2, 0);
+            for (long i1 = 0; i1 < size1; ++i1) {
+                for (long i2 = 0; i2 < size2; ++i2) {
+                    float j_row = (offset1 + 2 * i1) / 2.f;
+                    float j_col = (offset2 + 2 * i2) / 2.f;
+                    // Check the remaining triangle conditions
+                    if (l1 < std::abs(l2 - kappa) || l1 > l2 + kappa ||
+                        j_col < std::abs(j_row - kappa) || j_col > j_row + kappa) {
+                        continue;
+                    }
+                    values[i1 * size2 + i2] = std::pow(-1, int(l1 + s + j_col + kappa)) *
+                        std::sqrt((2 * j_row + 1) * (2 * j_col + 1)) *
+                        WignerSymbols::wigner6j(l1, j_row, s, j_col, l2, kappa);
+                }
+            }
+            return values;
+        });
+
+    return sgn * block[idx1 / 2 * size2 + idx2 / 2];
+}
+
+double AngularCoefficients::getReducedCommutesL(float s, int kappa, int l1, int l2, float j1,
+                                                float j2) {
+    // Use the symmetry of the Wigner 6j symbol to store only elements with l1 <= l2
+    int sgn = 1;
+    if (!((l1 < l2) || ((l1 == l2) && (j1 <= j2)))) {
+        sgn = std::pow(-1, int(l1 + j1 + l2 + j2 + 2 * s)); // TODO is this formula always correct?
+        std::swap(l1, l2);
+        std::swap(j1, j2);
+    }
+
+    // The coefficient vanishes unless j1 and j2 are in |l1-s|, ..., l1+s
+    long twos = std::lround(2 * s);
+    long offset = std::labs(2 * l1 - twos);
+    long size = std::min<long>(2 * l1, twos) + 1;
+    long idx1 = std::lround(2 * j1) - offset;
+    long idx2 = std::lround(2 * j2) - offset;
+    if (kappa < 0 || l1 < 0 || twos < 0 || idx1 < 0 || idx1 % 2 != 0 || idx1 / 2 >= size ||
+        idx2 < 0 || idx2 % 2 != 0 || idx2 / 2 >= size) {
+        return 0;
+    }
+
+    const auto &block = table_reduced_commutes_l.getBlock(
+        {{size_t(twos), size_t(kappa), size_t(l1)}}, [&]() {
+            std::vector<double> values(size * size, 0);
+            for (long i1 = 0; i1 < size; ++i1) {
+                for (long i2 = 0; i2 < size; ++i2) {
+                    float j_row = (offset + 2 * i1) / 2.f;
+                    float j_col = (offset + 2 * i2) / 2.f;
+                    // Check the remaining triangle conditions
+                    if (s < std::abs(s - kappa) || j_col < std::abs(j_row - kappa) ||
+                        j_col > j_row + kappa) {
+                        continue;
+                    }
+                    values[i1 * size + i2] = std::pow(-1, int(l1 + s + j_row + kappa)) *
+                        std::sqrt((2 * j_row + 1) * (2 * j_col + 1)) *
+                        WignerSymbols::wigner6j(s, j_row, l1, j_col, s, kappa);
+                }
+            }
+            return values;
+        });
+
+    return sgn * block[idx1 / 2 * size + idx2 / 2];
+}
+
+double AngularCoefficients::getReducedMultipole(int kappa, int l1, int l2) {
+    // Use the symmetry of the Wigner 3j symbol to store only elements with l1 <= l2
+    int sgn = 1;
+    if (l1 > l2) {
+        sgn = std::pow(-1, kappa);
+        std::swap(l1, l2);
+    }
+
+    // The coefficient vanishes unless l2 = l1, ..., l1+kappa
+    if (kappa < 0 || l1 < 0 || l2 - l1 > kappa) {
+        return 0;
+    }
+
+    const auto &block = table_reduced_multipole.getBlock({{size_t(kappa), size_t(l1)}}, [&]() {
+        std::vector<double> values(kappa + 1, 0);
+        for (int i = 0; i <= kappa; ++i) {
+            values[i] = std::pow(-1, l1) * std::sqrt((2 * l1 + 1) * (2 * (l1 + i) + 1)) *
+                WignerSymbols::wigner3j(l1, kappa, l1 + i, 0, 0, 0);
+        }
+        return values;
+    });
+
+    return sgn * block[l2 - l1];
+}
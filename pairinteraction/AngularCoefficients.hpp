@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANGULARCOEFFICIENTS_H
+#define ANGULARCOEFFICIENTS_H
+
+#include "CacheStatistics.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+/** \brief Tables of the angular parts of the matrix elements
+ *
+ * The angular coefficients only depend on the angular momentum quantum
+ * numbers of the states. They are stored in dense tables which are
+ * indexed by the doubled quantum numbers. Each table consists of blocks
+ * that contain all coefficients for a given combination of the outer
+ * quantum numbers, e.g. all (m1, m2) for given kappa, j1, and j2. A
+ * block is calculated the first time one of its coefficients is
+ * requested.
+ *
+ * The methods are thread-safe.
+ */
+class AngularCoefficients {
+public:
+    /** \brief Angular part of a multipole matrix element
+     *
+     * \returns (-1)^(j1-m1) * Wigner3j(j1, kappa, j2, -m1, m1-m2, m2)
+     */
+    double getAngular(int kappa, float j1, float j2, float m1, float m2);
+
+    /** \brief Reduced matrix element of an operator that commutes with the spin
+     *
+     * \returns (-1)^(l1+s+j2+kappa) * sqrt((2*j1+1)*(2*j2+1)) * Wigner6j(l1, j1, s, j2, l2, kappa)
+     */
+    double getReducedCommutesS(float s, int kappa, int l1, int l2, float j1, float j2);
+
+    /** \brief Reduced matrix element of an operator that commutes with the orbital angular
+     * momentum
+     *
+     * \returns (-1)^(l1+s+j1+kappa) * sqrt((2*j1+1)*(2*j2+1)) * Wigner6j(s, j1, l1, j2, s, kappa)
+     */
+    double getReducedCommutesL(float s, int kappa, int l1, int l2, float j1, float j2);
+
+    /** \brief Reduced matrix element of the spherical harmonics
+     *
+     * \returns (-1)^l1 * sqrt((2*l1+1)*(2*l2+1)) * Wigner3j(l1, kappa, l2, 0, 0, 0)
+     */
+    double getReducedMultipole(int kappa, int l1, int l2);
+
+    /** \brief Number of bytes allocated by the tables */
+    size_t memory() const;
+
+    /** \brief Lookups of the tables and time spent on calculating their blocks */
+    struct Statistics {
+        CacheTableStatistics angular;
+        CacheTableStatistics reduced_commutes_s;
+        CacheTableStatistics reduced_commutes_l;
+        CacheTableStatistics reduced_multipole;
+    };
+    Statistics getStatistics() const;
+    void resetStatistics();
+
+private:
+    /** \brief Lazily filled N-dimensional array of blocks
+     *
+     * The array grows when a block outside of its current shape is
+     * requested. The blocks are never removed, so that references to
+     * them stay valid.
+     */
+    template <size_t N>
+    class Table {
+    public:
+        template <typename F>
+        const std::vector<double> &getBlock(const std::array<size_t, N> &index, F &&calculate);
+        size_t memory() const;
+        CacheTableCounters counters;
+
+    private:
+        static size_t flatten(const std::array<size_t, N> &index,
+                              const std::array<size_t, N> &shape);
+        std::array<size_t, N> shape{};
+        std::vector<std::unique_ptr<const std::vector<double>>> blocks;
+        mutable std::shared_mutex mutex;
+    };
+
+    Table<3> table_angular;            // (kappa, 2*j1, 2*j2) -> (j1+m1, j2+m2)
+    Table<4> table_reduced_commutes_s; // (2*s, kappa, l1, l2) -> (j1-|l1-s|, j2-|l2-s|)
+    Table<3> table_reduced_commutes_l; // (2*s, kappa, l1) -> (j1-|l1-s|, j2-|l1-s|)
+    Table<2> table_reduced_multipole;  // (kappa, l1) -> (l2-l1)
+};
+
+#endif
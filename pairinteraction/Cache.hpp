@@ -20,10 +20,20 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <stdexcept>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 /** \brief Generic cache object
  *
@@ -100,4 +110,442 @@ public:
     void clear() { cache.clear(); }
 };
 
+/** \brief Generic cache object with a bounded size
+ *
+ * Like Cache, this cache is thread-safe and exposes only save,
+ * restore, and clear.  In contrast to Cache, the total size of the
+ * stored elements is bounded.  If saving an element exceeds the
+ * capacity, the least recently used elements are evicted.
+ *
+ * The size of an element is determined by a user-defined function,
+ * by default every element has size one so that the capacity is the
+ * maximum number of elements.
+ */
+template <typename Key, typename Element, typename Hash = std::hash<Key>>
+class LRUCache {
+    typedef std::list<std::pair<Key, Element>> list_t;
+    typedef std::unordered_map<Key, typename list_t::iterator, Hash> cache_t;
+
+    list_t entries; // most recently used entries first
+    cache_t cache;
+    std::function<std::size_t(Element const &)> size_of;
+    std::size_t capacity;
+    std::size_t size{0};
+    mutable std::mutex cache_mutex;
+
+    // Evict the least recently used elements until the size does not exceed the capacity, the
+    // most recently used elements are kept
+    void evict(std::size_t keep) {
+        while (size > capacity && entries.size() > keep) {
+            auto &last = entries.back();
+            size -= size_of(last.second);
+            cache.erase(last.first);
+            entries.pop_back();
+        }
+    }
+
+public:
+    /** \brief Constructor
+     *
+     * \param capacity Maximum total size of the stored elements
+     * \param size_of Function returning the size of an element
+     */
+    explicit LRUCache(
+        std::size_t capacity,
+        std::function<std::size_t(Element const &)> size_of = [](Element const &) { return 1; })
+        : size_of(std::move(size_of)), capacity(capacity) {}
+
+    /** \brief Save something in the cache
+     *
+     * Different from Cache, saving an element that is already in the
+     * cache is not an error.  If several threads calculate the same
+     * element concurrently, the element that was saved first is kept.
+     * The element that was saved last is never evicted by this call,
+     * even if its size exceeds the capacity.
+     *
+     * \param key Key
+     * \param e Element
+     */
+    void save(Key const &key, Element const &e) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if (cache.find(key) != cache.end()) {
+            return;
+        }
+
+        entries.emplace_front(key, e);
+        cache.emplace(key, entries.begin());
+        size += size_of(e);
+        evict(1);
+    }
+
+    /** \brief Restore something from the cache
+     *
+     * A successfully restored element is marked as most recently used.
+     *
+     * \param key Key
+     * \returns Optional element
+     */
+    std::optional<Element> restore(Key const &key) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto cached_it = cache.find(key);
+        if (cached_it != cache.end()) {
+            entries.splice(entries.begin(), entries, cached_it->second);
+            return cached_it->second->second;
+        }
+        return std::nullopt;
+    }
+
+    /** \brief Clear the cache
+     *
+     * Delete all elements in the cache
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache.clear();
+        entries.clear();
+        size = 0;
+    }
+
+    /** \brief Change the maximum total size of the stored elements
+     *
+     * If the stored elements are larger, the least recently used
+     * elements are evicted.
+     *
+     * \param c Capacity
+     */
+    void set_capacity(std::size_t c) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        capacity = c;
+        evict(0);
+    }
+
+    /** \brief Maximum total size of the stored elements */
+    std::size_t get_capacity() const {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return capacity;
+    }
+
+    /** \brief Total size of the stored elements */
+    std::size_t get_size() const {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return size;
+    }
+
+    /** \brief Number of stored elements */
+    std::size_t count() const {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return entries.size();
+    }
+};
+
+/** \brief Hash map with open addressing
+ *
+ * The keys and elements are stored in flat arrays and collisions are
+ * resolved by linear probing, so that a lookup touches few cache lines
+ * and does not follow pointers.  The map is meant for small, trivially
+ * comparable keys whose hash has good low bits.
+ *
+ * Elements are removed by evict(), which implements the CLOCK
+ * approximation of least-recently-used eviction: every lookup sets a
+ * reference flag of the element and the clock hand sweeps over the
+ * slots, clearing the flags, until it finds an element that has not
+ * been referenced since the last sweep.
+ *
+ * Concurrent calls of the const methods are thread-safe, all other
+ * methods require exclusive access.
+ */
+template <typename Key, typename Element, typename Hash = std::hash<Key>>
+class FlatHashMap {
+    std::vector<Key> keys;
+    std::vector<Element> elements;
+    std::vector<bool> occupied;
+    std::unique_ptr<std::atomic<bool>[]> referenced; // set by lookups, thus atomic
+    std::size_t num_elements{0};
+    std::size_t hand{0};
+    Hash hasher;
+
+    std::size_t capacity() const { return keys.size(); }
+
+    // Position of the key or of the empty slot where it belongs
+    std::size_t probe(Key const &key) const {
+        std::size_t mask = capacity() - 1;
+        std::size_t pos = hasher(key) & mask;
+        while (occupied[pos] && !(keys[pos] == key)) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    void move(std::size_t from, std::size_t to) {
+        keys[to] = std::move(keys[from]);
+        elements[to] = std::move(elements[from]);
+        occupied[to] = true;
+        referenced[to].store(referenced[from].load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+        occupied[from] = false;
+    }
+
+    void rehash(std::size_t new_capacity) {
+        FlatHashMap old;
+        std::swap(keys, old.keys);
+        std::swap(elements, old.elements);
+        std::swap(occupied, old.occupied);
+        std::swap(referenced, old.referenced);
+
+        keys.resize(new_capacity);
+        elements.resize(new_capacity);
+        occupied.assign(new_capacity, false);
+        referenced = std::make_unique<std::atomic<bool>[]>(new_capacity);
+        hand = 0;
+        for (std::size_t idx = 0; idx < old.capacity(); ++idx) {
+            if (old.occupied[idx]) {
+                std::size_t pos = probe(old.keys[idx]);
+                keys[pos] = std::move(old.keys[idx]);
+                elements[pos] = std::move(old.elements[idx]);
+                occupied[pos] = true;
+                referenced[pos].store(old.referenced[idx].load(std::memory_order_relaxed),
+                                      std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Remove the element at the position, the following elements of the cluster are shifted back
+    // so that they can still be found by linear probing
+    void erase(std::size_t pos) {
+        std::size_t mask = capacity() - 1;
+        occupied[pos] = false;
+        --num_elements;
+        for (std::size_t next = (pos + 1) & mask; occupied[next]; next = (next + 1) & mask) {
+            std::size_t ideal = hasher(keys[next]) & mask;
+            // Shift the element if the gap lies cyclically between its ideal position and itself
+            if (((next - ideal) & mask) >= ((next - pos) & mask)) {
+                move(next, pos);
+                pos = next;
+            }
+        }
+    }
+
+public:
+    /** \brief Look up an element
+     *
+     * \param key Key
+     * \returns Pointer to the element or nullptr if the key is not contained
+     */
+    Element const *find(Key const &key) const {
+        if (num_elements == 0) {
+            return nullptr;
+        }
+        std::size_t pos = probe(key);
+        if (!occupied[pos]) {
+            return nullptr;
+        }
+        referenced[pos].store(true, std::memory_order_relaxed);
+        return &elements[pos];
+    }
+
+    /** \brief Insert an element or overwrite the element of an existing key
+     *
+     * \param key Key
+     * \param e Element
+     */
+    void insert_or_assign(Key const &key, Element const &e) {
+        // Keep the load factor at most 1/2
+        if (2 * (num_elements + 1) > capacity()) {
+            rehash(std::max<std::size_t>(16, 2 * capacity()));
+        }
+        std::size_t pos = probe(key);
+        if (!occupied[pos]) {
+            keys[pos] = key;
+            occupied[pos] = true;
+            ++num_elements;
+        }
+        elements[pos] = e;
+        referenced[pos].store(true, std::memory_order_relaxed);
+    }
+
+    /** \brief Remove an element that has not been referenced recently
+     *
+     * \returns false if the map is empty
+     */
+    bool evict() {
+        if (num_elements == 0) {
+            return false;
+        }
+        std::size_t mask = capacity() - 1;
+        while (true) {
+            std::size_t pos = hand;
+            hand = (hand + 1) & mask;
+            if (occupied[pos] && !referenced[pos].exchange(false, std::memory_order_relaxed)) {
+                erase(pos);
+                hand = pos; // an element might have been shifted to this position
+                return true;
+            }
+        }
+    }
+
+    /** \brief Call a function for every key and element */
+    template <typename F>
+    void for_each(F &&f) const {
+        for (std::size_t idx = 0; idx < capacity(); ++idx) {
+            if (occupied[idx]) {
+                f(keys[idx], elements[idx]);
+            }
+        }
+    }
+
+    /** \brief Number of elements */
+    std::size_t size() const { return num_elements; }
+
+    /** \brief Number of bytes allocated for the slots */
+    std::size_t memory() const {
+        return capacity() * (sizeof(Key) + sizeof(Element) + sizeof(std::atomic<bool>)) +
+            occupied.capacity() / 8;
+    }
+
+    /** \brief Delete all elements */
+    void clear() {
+        keys.clear();
+        elements.clear();
+        occupied.clear();
+        referenced.reset();
+        num_elements = 0;
+        hand = 0;
+    }
+};
+
+/** \brief Generic cache object for many concurrent readers
+ *
+ * The elements are distributed over several shards, each of them a
+ * FlatHashMap protected by its own reader-writer lock.
+ * Threads that restore elements only take shared locks and threads
+ * that save elements only block the shard they write to.
+ *
+ * In addition to save, restore, and clear, the cache can be copied
+ * into a single `std::unordered_map`, e.g. for serialization.
+ *
+ * The number of elements can be bounded. Each shard holds at most its
+ * share of the capacity and evicts elements that have not been
+ * restored recently if saving an element exceeds it.
+ */
+template <typename Key, typename Element, typename Hash = std::hash<Key>,
+          std::size_t NumShards = 16>
+class ShardedCache {
+    typedef FlatHashMap<Key, Element, Hash> shard_t;
+    typedef std::unordered_map<Key, Element, Hash> cache_t;
+
+    struct Shard {
+        shard_t cache;
+        mutable std::shared_mutex cache_mutex;
+    };
+
+    std::array<Shard, NumShards> shards;
+    std::atomic<std::size_t> capacity{0};
+    Hash hasher;
+
+    // The shard is selected by the high bits of the mixed hash, so that the hash map of a shard
+    // can use the low bits
+    Shard &shard(Key const &key) {
+        return shards[((hasher(key) * 0x9e3779b97f4a7c15ULL) >> 32) % NumShards];
+    }
+
+    std::size_t capacity_of_shard() const {
+        std::size_t c = capacity.load();
+        return c == 0 ? 0 : std::max<std::size_t>(1, (c + NumShards - 1) / NumShards);
+    }
+
+public:
+    /** \brief Save something in the cache
+     *
+     * Different from Cache, an element that is already in the cache is
+     * overwritten.
+     *
+     * \param key Key
+     * \param e Element
+     */
+    void save(Key const &key, Element const &e) {
+        auto &s = shard(key);
+        std::size_t c = capacity_of_shard();
+        std::unique_lock<std::shared_mutex> lock(s.cache_mutex);
+        s.cache.insert_or_assign(key, e);
+        while (c != 0 && s.cache.size() > c) {
+            s.cache.evict();
+        }
+    }
+
+    /** \brief Restore something from the cache
+     *
+     * \param key Key
+     * \returns Optional element
+     */
+    std::optional<Element> restore(Key const &key) {
+        auto &s = shard(key);
+        std::shared_lock<std::shared_mutex> lock(s.cache_mutex);
+        if (auto const *cached = s.cache.find(key)) {
+            return *cached;
+        }
+        return std::nullopt;
+    }
+
+    /** \brief Number of elements in the cache */
+    std::size_t size() const {
+        std::size_t n = 0;
+        for (auto const &s : shards) {
+            std::shared_lock<std::shared_mutex> lock(s.cache_mutex);
+            n += s.cache.size();
+        }
+        return n;
+    }
+
+    /** \brief Number of bytes allocated by the cache */
+    std::size_t memory() const {
+        std::size_t bytes = sizeof(*this);
+        for (auto const &s : shards) {
+            std::shared_lock<std::shared_mutex> lock(s.cache_mutex);
+            bytes += s.cache.memory();
+        }
+        return bytes;
+    }
+
+    /** \brief Bound the number of elements
+     *
+     * If the cache contains more elements, elements are evicted.
+     *
+     * \param c Maximum number of elements, zero means unbounded
+     */
+    void set_capacity(std::size_t c) {
+        capacity = c;
+        std::size_t cs = capacity_of_shard();
+        for (auto &s : shards) {
+            std::unique_lock<std::shared_mutex> lock(s.cache_mutex);
+            while (cs != 0 && s.cache.size() > cs) {
+                s.cache.evict();
+            }
+        }
+    }
+
+    /** \brief Maximum number of elements, zero means unbounded */
+    std::size_t get_capacity() const { return capacity; }
+
+    /** \brief Copy all elements into a single map */
+    cache_t copy() const {
+        cache_t all;
+        for (auto const &s : shards) {
+            std::shared_lock<std::shared_mutex> lock(s.cache_mutex);
+            s.cache.for_each([&](Key const &key, Element const &e) { all.emplace(key, e); });
+        }
+        return all;
+    }
+
+    /** \brief Clear the cache
+     *
+     * Delete all elements in the cache
+     */
+    void clear() {
+        for (auto &s : shards) {
+            std::unique_lock<std::shared_mutex> lock(s.cache_mutex);
+            s.cache.clear();
+        }
+    }
+};
+
 #endif // CACHE_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CACHESTATISTICS_H
+#define CACHESTATISTICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+/** \brief Counters and cumulative timers of a table of a cache
+ *
+ * A lookup is either a hit, i.e. the value is found in the memory,
+ * or a miss. Missing values are loaded from the read-only store or the
+ * database, or they are calculated. The times are summed over all
+ * threads and are given in seconds.
+ */
+struct CacheTableStatistics {
+    size_t hits{0};
+    size_t misses{0};
+    size_t store_hits{0};
+    size_t database_hits{0};
+    size_t calculations{0};
+    double store_seconds{0};
+    double database_seconds{0};
+    double calculation_seconds{0};
+};
+
+#ifndef SWIG
+/** \brief Thread-safe accumulator of CacheTableStatistics
+ *
+ * Each thread counts into one of several shards, which occupy separate cache lines, so that
+ * threads looking up elements concurrently do not contend for the same counters. The counters are
+ * incremented with relaxed memory ordering and the shards are summed by snapshot(). A snapshot
+ * that is taken while other threads use the table might therefore be slightly inconsistent.
+ */
+class CacheTableCounters {
+public:
+    struct alignas(64) Shard {
+        std::atomic<size_t> hits{0};
+        std::atomic<size_t> misses{0};
+        std::atomic<size_t> store_hits{0};
+        std::atomic<size_t> database_hits{0};
+        std::atomic<size_t> calculations{0};
+        std::atomic<int64_t> store_nanoseconds{0};
+        std::atomic<int64_t> database_nanoseconds{0};
+        std::atomic<int64_t> calculation_nanoseconds{0};
+    };
+
+    /** \brief Shard of the calling thread */
+    Shard &local() { return shards[getThreadIndex() % num_shards]; }
+
+    static void add(std::atomic<size_t> &counter, size_t n = 1) {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    CacheTableStatistics snapshot() const {
+        CacheTableStatistics statistics;
+        int64_t store_nanoseconds = 0;
+        int64_t database_nanoseconds = 0;
+        int64_t calculation_nanoseconds = 0;
+        for (const auto &shard : shards) {
+            statistics.hits += shard.hits.load(std::memory_order_relaxed);
+            statistics.misses += shard.misses.load(std::memory_order_relaxed);
+            statistics.store_hits += shard.store_hits.load(std::memory_order_relaxed);
+            statistics.database_hits += shard.database_hits.load(std::memory_order_relaxed);
+            statistics.calculations += shard.calculations.load(std::memory_order_relaxed);
+            store_nanoseconds += shard.store_nanoseconds.load(std::memory_order_relaxed);
+            database_nanoseconds += shard.database_nanoseconds.load(std::memory_order_relaxed);
+            calculation_nanoseconds +=
+                shard.calculation_nanoseconds.load(std::memory_order_relaxed);
+        }
+        statistics.store_seconds = store_nanoseconds * 1e-9;
+        statistics.database_seconds = database_nanoseconds * 1e-9;
+        statistics.calculation_seconds = calculation_nanoseconds * 1e-9;
+        return statistics;
+    }
+
+    void reset() {
+        for (auto &shard : shards) {
+            for (auto *counter : {&shard.hits, &shard.misses, &shard.store_hits,
+                                  &shard.database_hits, &shard.calculations}) {
+                counter->store(0, std::memory_order_relaxed);
+            }
+            for (auto *timer : {&shard.store_nanoseconds, &shard.database_nanoseconds,
+                                &shard.calculation_nanoseconds}) {
+                timer->store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    // Index of the calling thread, assigned when the thread counts for the first time
+    static size_t getThreadIndex() {
+        static std::atomic<size_t> num_threads{0};
+        thread_local size_t index = num_threads.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    static constexpr size_t num_shards = 32;
+    std::array<Shard, num_shards> shards;
+};
+
+/** \brief Add the lifetime of the object to a timer of CacheTableCounters */
+class CacheTableTimer {
+public:
+    explicit CacheTableTimer(std::atomic<int64_t> &nanoseconds)
+        : nanoseconds(nanoseconds), start(std::chrono::steady_clock::now()) {}
+    CacheTableTimer(const CacheTableTimer &) = delete;
+    CacheTableTimer &operator=(const CacheTableTimer &) = delete;
+    ~CacheTableTimer() {
+        auto duration = std::chrono::steady_clock::now() - start;
+        nanoseconds.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(),
+            std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> &nanoseconds;
+    std::chrono::steady_clock::time_point start;
+};
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseWriter.hpp"
+#include "SQLite.hpp"
+#include "utils.hpp"
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+DatabaseWriter::DatabaseWriter(std::string dbname)
+    : pid(utils::get_pid()), shared(std::make_unique<Shared>()) {
+    shared->dbname = std::move(dbname);
+    thread = std::make_unique<std::thread>(&DatabaseWriter::run, std::ref(*shared));
+}
+
+DatabaseWriter::~DatabaseWriter() {
+    // The background thread has not been forked into this process, thus the thread object and the
+    // shared state are leaked (destroying them would terminate the process or wait forever)
+    if (pid != utils::get_pid()) {
+        static_cast<void>(thread.release());
+        static_cast<void>(shared.release());
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->stopping = true;
+    }
+    shared->cv_queued.notify_one();
+    thread->join();
+
+    if (shared->exception) {
+        try {
+            std::rethrow_exception(shared->exception);
+        } catch (std::exception &e) {
+            std::cerr << "WARNING: Matrix elements could not be written to the database "
+                      << shared->dbname << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+void DatabaseWriter::push(std::vector<Row> rows) {
+    if (rows.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        if (shared->queue.empty()) {
+            shared->queue = std::move(rows);
+        } else {
+            shared->queue.insert(shared->queue.end(), std::make_move_iterator(rows.begin()),
+                                 std::make_move_iterator(rows.end()));
+        }
+    }
+    shared->cv_queued.notify_one();
+}
+
+void DatabaseWriter::flush() {
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->cv_written.wait(lock, [this]() { return shared->queue.empty() && !shared->writing; });
+    if (shared->exception) {
+        std::rethrow_exception(std::exchange(shared->exception, nullptr));
+    }
+}
+
+void DatabaseWriter::run(Shared &shared) {
+    std::unique_lock<std::mutex> lock(shared.mutex);
+    while (true) {
+        shared.cv_queued.wait(lock, [&]() { return shared.stopping || !shared.queue.empty(); });
+        if (shared.queue.empty()) {
+            break;
+        }
+
+        // Write all rows that have been queued so far without holding the lock
+        std::vector<Row> rows;
+        rows.swap(shared.queue);
+        shared.writing = true;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            write(shared.dbname, rows);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (error && !shared.exception) {
+            shared.exception = error;
+        }
+        shared.writing = false;
+        shared.cv_written.notify_all();
+    }
+}
+
+void DatabaseWriter::write(std::string const &dbname, std::vector<Row> const &rows) {
+    sqlite::handle db(dbname);
+    sqlite::statement stmt(db);
+    stmt.exec("PRAGMA synchronous = NORMAL"); // durable enough in write-ahead logging mode
+
+    // Acquire the write lock at the beginning of the transaction so that waiting for other
+    // writers is handled by the busy handler
+    stmt.exec("begin immediate transaction;");
+    try {
+        stmt.set("insert or ignore into cache_radial (method, species, k, n1, l1, j1, n2, l2, j2, "
+                 "value) values (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10);");
+        stmt.prepare();
+        for (auto const &row : rows) {
+            stmt.bind(1, row.method);
+            stmt.bind(2, row.species);
+            stmt.bind(3, row.kappa);
+            stmt.bind(4, row.n1);
+            stmt.bind(5, row.l1);
+            stmt.bind(6, row.j1);
+            stmt.bind(7, row.n2);
+            stmt.bind(8, row.l2);
+            stmt.bind(9, row.j2);
+            stmt.bind(10, row.value);
+            stmt.step();
+            stmt.reset();
+        }
+        stmt.exec("commit transaction;");
+    } catch (...) {
+        stmt.exec("rollback transaction;");
+        throw;
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASEWRITER_H
+#define DATABASEWRITER_H
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** \brief Background writer of radial matrix elements to the SQLite database of the cache
+ *
+ * The rows passed to push() are queued and written by a background
+ * thread, which uses its own connection to the database and writes all
+ * rows that have been queued in the meantime within a single
+ * transaction. Thus, calculating matrix elements never waits for the
+ * database.
+ *
+ * The database is used in write-ahead logging mode, so that several
+ * processes can read from and append to the same database
+ * concurrently. If another process is writing, the writer waits until
+ * the database is unlocked (see sqlite::handle). Note that write-ahead
+ * logging does not work on network file systems.
+ *
+ * Errors of the background thread are reported by the next call of
+ * flush(). A writer that has been copied into a different process by
+ * forking must not be used, but it can be destroyed.
+ */
+class DatabaseWriter {
+public:
+    /** \brief Row of the table cache_radial */
+    struct Row {
+        int method;
+        std::string species;
+        int kappa;
+        int n1, l1;
+        double j1;
+        int n2, l2;
+        double j2;
+        double value;
+    };
+
+    /** \brief Start the background thread
+     *
+     * \param dbname Path to the database, the table cache_radial must exist
+     */
+    explicit DatabaseWriter(std::string dbname);
+
+    /** \brief Write the remaining rows and stop the background thread */
+    ~DatabaseWriter();
+
+    DatabaseWriter(const DatabaseWriter &) = delete;
+    DatabaseWriter &operator=(const DatabaseWriter &) = delete;
+
+    /** \brief Queue rows for writing
+     *
+     * \param rows Rows, already existing rows are not overwritten
+     */
+    void push(std::vector<Row> rows);
+
+    /** \brief Wait until all queued rows have been written
+     *
+     * \throws sqlite::error if writing failed
+     */
+    void flush();
+
+private:
+    // State shared with the background thread
+    struct Shared {
+        std::string dbname;
+        std::mutex mutex;
+        std::condition_variable cv_queued;
+        std::condition_variable cv_written;
+        std::vector<Row> queue;
+        bool writing{false};
+        bool stopping{false};
+        std::exception_ptr exception;
+    };
+
+    static void run(Shared &shared);
+    static void write(std::string const &dbname, std::vector<Row> const &rows);
+
+    long pid;
+    std::unique_ptr<Shared> shared;
+    std::unique_ptr<std::thread> thread;
+};
+
+#endif
@@ -0,0 +1,704 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EIGENSOLVER_H
+#define EIGENSOLVER_H
+
+#include <Eigen/Dense>
+#include <Eigen/Eigenvalues>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <Eigen/SparseLU>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace eigensolver {
+
+/** \brief Eigenpairs of a Hermitian matrix
+ *
+ * The eigenvalues are sorted in ascending order, the k-th column of
+ * `vectors` is the normalized eigenvector that belongs to the k-th
+ * eigenvalue.
+ */
+template <typename Scalar>
+struct Eigenpairs {
+    Eigen::Matrix<double, Eigen::Dynamic, 1> values;
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> vectors;
+};
+
+/** \brief One-norm of a sparse matrix
+ *
+ * The one-norm is an upper bound of the spectral radius and thus
+ * gives a cheap estimate of the scale of the spectrum.
+ *
+ * \param mat  sparse matrix
+ * \returns maximum absolute column sum
+ */
+template <typename Scalar>
+double normOne(const Eigen::SparseMatrix<Scalar> &mat) {
+    double norm = 0;
+    for (int k = 0; k < mat.outerSize(); ++k) {
+        double sum = 0;
+        for (typename Eigen::SparseMatrix<Scalar>::InnerIterator triple(mat, k); triple;
+             ++triple) {
+            sum += std::abs(triple.value());
+        }
+        norm = std::max(norm, sum);
+    }
+    return norm;
+}
+
+/** \brief Decompose a matrix into blocks that are not coupled to each other
+ *
+ * The rows and columns of a square matrix are interpreted as the vertices
+ * of a graph whose edges are given by the non-zero entries. The connected
+ * components of this graph are the blocks into which the matrix can be
+ * decomposed by a permutation. If the matrix is Hermitian, each block can
+ * be diagonalized independently.
+ *
+ * \param mat  square sparse matrix
+ * \returns indices belonging to the blocks, the indices within a block and the blocks
+ * themselves are sorted in ascending order of their (first) index
+ */
+template <typename Scalar>
+std::vector<std::vector<int>> findBlocks(const Eigen::SparseMatrix<Scalar> &mat) {
+    const int n = mat.outerSize();
+
+    // Determine the connected components using union-find
+    std::vector<int> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](int idx) {
+        while (parent[idx] != idx) {
+            parent[idx] = parent[parent[idx]];
+            idx = parent[idx];
+        }
+        return idx;
+    };
+
+    for (int k = 0; k < n; ++k) {
+        for (typename Eigen::SparseMatrix<Scalar>::InnerIterator triple(mat, k); triple;
+             ++triple) {
+            if (triple.value() == Scalar(0)) {
+                continue;
+            }
+            int root_row = find(triple.row());
+            int root_col = find(triple.col());
+            if (root_row != root_col) {
+                parent[std::max(root_row, root_col)] = std::min(root_row, root_col);
+            }
+        }
+    }
+
+    // Group the indices by their components
+    std::vector<std::vector<int>> blocks;
+    std::vector<int> block_of_root(n, -1);
+    for (int idx = 0; idx < n; ++idx) {
+        int root = find(idx);
+        if (block_of_root[root] == -1) {
+            block_of_root[root] = blocks.size();
+            blocks.emplace_back();
+        }
+        blocks[block_of_root[root]].push_back(idx);
+    }
+
+    return blocks;
+}
+
+/** \brief Number of eigenvalues of a symmetric tridiagonal matrix below a value
+ *
+ * The number is obtained from the signs of the pivots of the LDL^T
+ * decomposition of the shifted matrix (Sturm sequence).
+ *
+ * \param diagonal  diagonal of the tridiagonal matrix
+ * \param subdiagonal  subdiagonal of the tridiagonal matrix
+ * \param value  value to compare with
+ * \param pivmin  minimum absolute value of a pivot
+ * \returns number of eigenvalues that are smaller than \p value
+ */
+inline int countEigenvaluesBelow(const Eigen::VectorXd &diagonal,
+                                 const Eigen::VectorXd &subdiagonal, double value,
+                                 double pivmin) {
+    int count = 0;
+    double pivot = 1;
+    for (int i = 0; i < diagonal.size(); ++i) {
+        pivot = diagonal[i] - value - (i > 0 ? subdiagonal[i - 1] * subdiagonal[i - 1] / pivot : 0);
+        if (std::abs(pivot) < pivmin) {
+            pivot = -pivmin;
+        }
+        if (pivot < 0) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+/** \brief Eigenvector of a symmetric tridiagonal matrix by inverse iteration
+ *
+ * The shifted tridiagonal matrix is decomposed by Gaussian elimination
+ * with partial pivoting. The start vector is then repeatedly multiplied
+ * with the inverse of the shifted matrix. After each step, the vector is
+ * orthogonalized against the already known eigenvectors of the same
+ * cluster of eigenvalues.
+ *
+ * \param diagonal  diagonal of the tridiagonal matrix
+ * \param subdiagonal  subdiagonal of the tridiagonal matrix
+ * \param eigenvalue  eigenvalue whose eigenvector is calculated
+ * \param cluster  eigenvectors of close-by eigenvalues
+ * \param vector  start vector, gets overwritten by the normalized eigenvector
+ * \param pivmin  minimum absolute value of a pivot
+ */
+inline void inverseIteration(const Eigen::VectorXd &diagonal, const Eigen::VectorXd &subdiagonal,
+                             double eigenvalue, const Eigen::MatrixXd &cluster,
+                             Eigen::VectorXd &vector, double pivmin) {
+    const int n = diagonal.size();
+
+    // Decompose the shifted matrix, multipliers are stored in lower and the upper triangular
+    // matrix has the diagonals upper0, upper1, and upper2
+    Eigen::VectorXd upper0 = diagonal.array() - eigenvalue;
+    Eigen::VectorXd upper1 = subdiagonal;
+    Eigen::VectorXd upper2 = Eigen::VectorXd::Zero(std::max(n - 2, 0));
+    Eigen::VectorXd lower = subdiagonal;
+    std::vector<bool> is_swapped(std::max(n - 1, 0), false);
+
+    for (int i = 0; i < n - 1; ++i) {
+        if (std::abs(upper0[i]) >= std::abs(lower[i])) {
+            if (std::abs(upper0[i]) < pivmin) {
+                upper0[i] = pivmin;
+            }
+            double factor = lower[i] / upper0[i];
+            lower[i] = factor;
+            upper0[i + 1] -= factor * upper1[i];
+        } else {
+            double factor = upper0[i] / lower[i];
+            upper0[i] = lower[i];
+            lower[i] = factor;
+            double tmp = upper1[i];
+            upper1[i] = upper0[i + 1];
+            upper0[i + 1] = tmp - factor * upper0[i + 1];
+            if (i < n - 2) {
+                upper2[i] = upper1[i + 1];
+                upper1[i + 1] = -factor * upper1[i + 1];
+            }
+            is_swapped[i] = true;
+        }
+    }
+    if (std::abs(upper0[n - 1]) < pivmin) {
+        upper0[n - 1] = pivmin;
+    }
+
+    // Apply the inverse of the decomposed matrix a few times
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        for (int i = 0; i < n - 1; ++i) {
+            if (is_swapped[i]) {
+                double tmp = vector[i];
+                vector[i] = vector[i + 1];
+                vector[i + 1] = tmp - lower[i] * vector[i];
+            } else {
+                vector[i + 1] -= lower[i] * vector[i];
+            }
+        }
+        for (int i = n - 1; i >= 0; --i) {
+            double val = vector[i];
+            if (i < n - 1) {
+                val -= upper1[i] * vector[i + 1];
+            }
+            if (i < n - 2) {
+                val -= upper2[i] * vector[i + 2];
+            }
+            vector[i] = val / upper0[i];
+        }
+
+        // Orthogonalize against eigenvectors of close-by eigenvalues and normalize
+        if (cluster.cols() > 0) {
+            vector -= cluster * (cluster.transpose() * vector);
+        }
+        vector.normalize();
+    }
+}
+
+/** \brief Selected eigenpairs of a dense Hermitian matrix by bisection and inverse iteration
+ *
+ * The matrix is reduced to a real symmetric tridiagonal matrix by
+ * Householder transformations. The selected eigenvalues of the
+ * tridiagonal matrix are located by bisection, the corresponding
+ * eigenvectors are obtained by inverse iteration and transformed back.
+ * Thus, only the selected eigenvectors are calculated and stored.
+ *
+ * \param mat  dense Hermitian matrix
+ * \param range  'V' to select the eigenvalues in the half-open interval (\p
+ * energy_lower_bound, \p energy_upper_bound], 'I' to select the eigenvalues with the
+ * zero-based indices \p index_lower to \p index_upper
+ * \param energy_lower_bound  lower bound of the energy window
+ * \param energy_upper_bound  upper bound of the energy window
+ * \param index_lower  index of the smallest selected eigenvalue
+ * \param index_upper  index of the largest selected eigenvalue
+ * \returns selected eigenpairs
+ */
+template <typename Scalar>
+Eigenpairs<Scalar> bisection(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &mat,
+                             char range, double energy_lower_bound, double energy_upper_bound,
+                             int index_lower, int index_upper) {
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> dense_t;
+
+    const int n = mat.rows();
+    Eigenpairs<Scalar> eigenpairs;
+    eigenpairs.values.resize(0);
+    eigenpairs.vectors.resize(n, 0);
+    if (n == 0) {
+        return eigenpairs;
+    }
+
+    // Reduce the matrix to tridiagonal form
+    Eigen::Tridiagonalization<dense_t> tridiagonalization(mat);
+    Eigen::VectorXd diagonal = tridiagonalization.diagonal();
+    Eigen::VectorXd subdiagonal = tridiagonalization.subDiagonal();
+
+    // Gershgorin bounds of the spectrum
+    double spectrum_lower_bound = std::numeric_limits<double>::max();
+    double spectrum_upper_bound = std::numeric_limits<double>::lowest();
+    double max_subdiagonal_squared = 1;
+    for (int i = 0; i < n; ++i) {
+        double radius = (i > 0 ? std::abs(subdiagonal[i - 1]) : 0) +
+            (i < n - 1 ? std::abs(subdiagonal[i]) : 0);
+        spectrum_lower_bound = std::min(spectrum_lower_bound, diagonal[i] - radius);
+        spectrum_upper_bound = std::max(spectrum_upper_bound, diagonal[i] + radius);
+        if (i < n - 1) {
+            max_subdiagonal_squared =
+                std::max(max_subdiagonal_squared, subdiagonal[i] * subdiagonal[i]);
+        }
+    }
+    const double norm = std::max(std::abs(spectrum_lower_bound), std::abs(spectrum_upper_bound));
+    const double eps = std::numeric_limits<double>::epsilon();
+    const double pivmin = std::numeric_limits<double>::min() * max_subdiagonal_squared;
+
+    // Determine the indices of the selected eigenvalues
+    if (range == 'V') {
+        const double infinity = std::numeric_limits<double>::infinity();
+        index_lower = countEigenvaluesBelow(diagonal, subdiagonal,
+                                            std::nextafter(energy_lower_bound, infinity), pivmin);
+        index_upper = countEigenvaluesBelow(diagonal, subdiagonal,
+                                            std::nextafter(energy_upper_bound, infinity), pivmin) -
+            1;
+    } else if (range != 'I') {
+        throw std::runtime_error("The range must be either 'V' or 'I'.");
+    }
+    index_lower = std::max(index_lower, 0);
+    index_upper = std::min(index_upper, n - 1);
+    const int m = std::max(index_upper - index_lower + 1, 0);
+
+    // Locate the eigenvalues by bisection
+    eigenpairs.values.resize(m);
+    double lower = spectrum_lower_bound - 2 * eps * norm - pivmin;
+    for (int k = 0; k < m; ++k) {
+        double upper = spectrum_upper_bound + 2 * eps * norm + pivmin;
+        while (upper - lower > 2 * eps * std::max(std::abs(lower), std::abs(upper)) + pivmin) {
+            double middle = 0.5 * (lower + upper);
+            if (middle == lower || middle == upper) {
+                break;
+            }
+            if (countEigenvaluesBelow(diagonal, subdiagonal, middle, pivmin) > index_lower + k) {
+                upper = middle;
+            } else {
+                lower = middle;
+            }
+        }
+        eigenpairs.values[k] = 0.5 * (lower + upper);
+        lower = std::min(lower, eigenpairs.values[k]);
+    }
+
+    // Calculate the eigenvectors of the tridiagonal matrix by inverse iteration, eigenvectors
+    // belonging to eigenvalues that are closer than the threshold used by LAPACK's ?stein are
+    // orthogonalized against each other
+    std::default_random_engine engine(0);
+    std::uniform_real_distribution<double> distribution(-1, 1);
+
+    Eigen::MatrixXd vectors_tridiagonal(n, m);
+    int cluster_begin = 0;
+    for (int k = 0; k < m; ++k) {
+        if (k > 0 && eigenpairs.values[k] - eigenpairs.values[k - 1] > 1e-3 * norm) {
+            cluster_begin = k;
+        }
+        Eigen::VectorXd vector(n);
+        for (int i = 0; i < n; ++i) {
+            vector[i] = distribution(engine);
+        }
+        inverseIteration(diagonal, subdiagonal, eigenpairs.values[k],
+                         vectors_tridiagonal.middleCols(cluster_begin, k - cluster_begin), vector,
+                         std::max(pivmin, eps * norm));
+        vectors_tridiagonal.col(k) = vector;
+    }
+
+    // Transform the eigenvectors back
+    eigenpairs.vectors = tridiagonalization.matrixQ() * vectors_tridiagonal.cast<Scalar>();
+
+    return eigenpairs;
+}
+
+/** \brief Orthonormalize a block of vectors against a basis
+ *
+ * The columns of \p block are made orthogonal to the columns of \p
+ * basis, which must be orthonormal, and to each other.  Columns that
+ * turn out to be linearly dependent are replaced by random vectors so
+ * that the block keeps its size.
+ *
+ * \param basis  orthonormal basis
+ * \param block  block of vectors that gets orthonormalized in-place
+ * \param engine  random engine used to replace dependent columns
+ */
+template <typename Scalar, typename Engine>
+void orthonormalize(const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &basis,
+                    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &block, Engine &engine) {
+    std::normal_distribution<double> distribution;
+
+    for (int col = 0; col < block.cols(); ++col) {
+        for (int attempt = 0;; ++attempt) {
+            double norm_before = block.col(col).norm();
+
+            // Classical Gram-Schmidt, applied twice for numerical stability
+            for (int pass = 0; pass < 2; ++pass) {
+                if (basis.cols() > 0) {
+                    block.col(col) -= basis * (basis.adjoint() * block.col(col));
+                }
+                if (col > 0) {
+                    block.col(col) -=
+                        block.leftCols(col) * (block.leftCols(col).adjoint() * block.col(col));
+                }
+            }
+
+            double norm_after = block.col(col).norm();
+            if (norm_after > 1e-8 * norm_before && norm_after > 0) {
+                block.col(col) /= norm_after;
+                break;
+            }
+            if (attempt > 10) {
+                throw std::runtime_error("The Krylov subspace could not be extended.");
+            }
+
+            // The column is linearly dependent, replace it by a random vector
+            for (int row = 0; row < block.rows(); ++row) {
+                block(row, col) = distribution(engine);
+            }
+        }
+    }
+}
+
+/** \brief Number of eigenvalues of a sparse Hermitian matrix below a value
+ *
+ * The number is obtained from the inertia of the shifted matrix
+ * (Sylvester's law of inertia), i.e. from the number of negative
+ * entries of D of its LDL^T decomposition. As the sparse decomposition
+ * does not pivot, small pivots can cause a growth of the entries of L
+ * that makes the signs of D unreliable. Thus, the decomposition is
+ * checked by solving a linear system with it. If the decomposition
+ * fails or the relative residual of the solution is large, the value
+ * is slightly increased.
+ *
+ * \param hamiltonian  sparse Hermitian matrix
+ * \param value  value to compare with
+ * \returns number of eigenvalues that are smaller than \p value, or -1 if no accurate
+ * decomposition of the shifted matrix was found
+ */
+template <typename Scalar>
+int countEigenvaluesBelow(const Eigen::SparseMatrix<Scalar> &hamiltonian, double value) {
+    typedef Eigen::SparseMatrix<Scalar> sparse_t;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> vector_t;
+
+    const int n = hamiltonian.rows();
+    sparse_t identity(n, n);
+    identity.setIdentity();
+
+    const double scale = std::max(normOne(hamiltonian), std::numeric_limits<double>::min());
+
+    std::default_random_engine engine(0);
+    std::normal_distribution<double> distribution;
+    vector_t rhs(n);
+    for (int i = 0; i < n; ++i) {
+        rhs[i] = distribution(engine);
+    }
+
+    Eigen::SimplicialLDLT<sparse_t, Eigen::Lower, Eigen::AMDOrdering<int>> solver;
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        if (attempt > 0) {
+            value += scale * 1e-14 * attempt;
+        }
+        sparse_t shifted = hamiltonian - Scalar(value) * identity;
+        solver.compute(shifted);
+        if (solver.info() != Eigen::Success) {
+            continue;
+        }
+
+        vector_t solution = solver.solve(rhs);
+        double residual = (shifted * solution - rhs).norm();
+        if (!std::isfinite(residual) || residual > 1e-8 * (scale * solution.norm() + rhs.norm())) {
+            continue;
+        }
+
+        int count = 0;
+        for (int i = 0; i < n; ++i) {
+            if (std::real(solver.vectorD()[i]) < 0) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    return -1;
+}
+
+/** \brief Eigenpairs within an energy window using shift-invert block Lanczos
+ *
+ * The eigenpairs of the sparse Hermitian matrix \p hamiltonian whose
+ * eigenvalues lie inside the interval [\p energy_lower_bound, \p
+ * energy_upper_bound] are calculated without ever forming a dense
+ * matrix of the size of \p hamiltonian. The matrix shifted by the
+ * center of the interval is factorized once using a sparse LU
+ * decomposition. The inverse of the shifted matrix is then applied to
+ * a block of vectors in order to build a block Krylov subspace whose
+ * Ritz pairs converge fastest for the eigenvalues close to the shift.
+ * The number of eigenvalues inside the interval is determined
+ * beforehand by counting the eigenvalues below its bounds. The Krylov
+ * subspace is fully reorthogonalized and extended until this number
+ * of Ritz pairs inside the interval has converged. Eigenvalues that are
+ * closer to the bounds of the interval than the tolerance may or may not
+ * be found, since the counts are not more accurate.
+ *
+ * If the number of eigenvalues cannot be determined reliably or the
+ * Krylov subspace would grow beyond a quarter of the size of \p
+ * hamiltonian, the eigenpairs are calculated by bisection of the dense
+ * matrix instead, which is cheaper than such a large subspace.
+ *
+ * The block size is derived from the number of eigenvalues inside the
+ * interval. Degenerate eigenspaces are only resolved completely if
+ * their dimension does not exceed the block size.
+ *
+ * If an initial subspace is given, e.g. the eigenvectors of the
+ * previous step of a sweep, it is used as the first block of the
+ * Krylov subspace. If it already contains good approximations of the
+ * searched eigenvectors, only a few extensions are needed. At most as
+ * many of its leading vectors as the number of eigenvalues in the
+ * window plus ten are used.
+ *
+ * \param hamiltonian  sparse Hermitian matrix
+ * \param energy_lower_bound  lower bound of the energy window
+ * \param energy_upper_bound  upper bound of the energy window
+ * \param initial_subspace  vectors that span the initial subspace, might be empty
+ * \param tolerance  residual norm, relative to the one-norm of \p hamiltonian, below which
+ * a Ritz pair is considered as converged
+ * \returns eigenpairs whose eigenvalues lie inside the energy window
+ * \throws std::runtime_error if the shifted matrix cannot be factorized
+ */
+template <typename Scalar>
+Eigenpairs<Scalar> shiftInvertLanczos(const Eigen::SparseMatrix<Scalar> &hamiltonian,
+                                      double energy_lower_bound, double energy_upper_bound,
+                                      const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>
+                                          &initial_subspace = {},
+                                      double tolerance = 1e-10) {
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> dense_t;
+    typedef Eigen::SparseMatrix<Scalar> sparse_t;
+
+    const int n = hamiltonian.rows();
+    Eigenpairs<Scalar> eigenpairs;
+    eigenpairs.values.resize(0);
+    eigenpairs.vectors.resize(n, 0);
+
+    // Restrict the window to the Gershgorin bounds of the spectrum
+    double spectrum_lower_bound = std::numeric_limits<double>::max();
+    double spectrum_upper_bound = std::numeric_limits<double>::lowest();
+    for (int k = 0; k < hamiltonian.outerSize(); ++k) {
+        double center = 0;
+        double radius = 0;
+        for (typename sparse_t::InnerIterator triple(hamiltonian, k); triple; ++triple) {
+            if (triple.row() == triple.col()) {
+                center = std::real(triple.value());
+            } else {
+                radius += std::abs(triple.value());
+            }
+        }
+        spectrum_lower_bound = std::min(spectrum_lower_bound, center - radius);
+        spectrum_upper_bound = std::max(spectrum_upper_bound, center + radius);
+    }
+    double lower = std::max(energy_lower_bound, spectrum_lower_bound);
+    double upper = std::min(energy_upper_bound, spectrum_upper_bound);
+    if (n == 0 || lower > upper) {
+        return eigenpairs;
+    }
+    const double scale = std::max(normOne(hamiltonian), std::numeric_limits<double>::min());
+
+    // Calculate the eigenpairs inside the window from the dense matrix
+    auto diagonalizeDense = [&]() {
+        return bisection(dense_t(hamiltonian), 'V',
+                         std::nextafter(energy_lower_bound, spectrum_lower_bound - 1),
+                         energy_upper_bound, 0, 0);
+    };
+
+    // Count the eigenvalues inside the window
+    const int num_below_upper =
+        countEigenvaluesBelow(hamiltonian, std::nextafter(upper, spectrum_upper_bound + 1));
+    const int num_below_lower = countEigenvaluesBelow(hamiltonian, lower);
+    if (num_below_upper < 0 || num_below_lower < 0) {
+        return diagonalizeDense();
+    }
+    const int num_eigenvalues = num_below_upper - num_below_lower;
+    if (num_eigenvalues <= 0) {
+        return eigenpairs;
+    }
+
+    // Factorize the shifted Hamiltonian, nudge the shift if it hits an eigenvalue
+    sparse_t identity(n, n);
+    identity.setIdentity();
+
+    Eigen::SparseLU<sparse_t, Eigen::COLAMDOrdering<int>> solver;
+    double sigma = 0.5 * (lower + upper);
+    for (int attempt = 0;; ++attempt) {
+        sparse_t shifted = hamiltonian - Scalar(sigma) * identity;
+        shifted.makeCompressed();
+        solver.compute(shifted);
+        if (solver.info() == Eigen::Success) {
+            break;
+        }
+        if (attempt > 5) {
+            throw std::runtime_error("Factorization of the shifted Hamiltonian failed.");
+        }
+        sigma += std::max(upper - lower, scale * 1e-12) * 1e-6 * (attempt + 1);
+    }
+
+    // Initialize the block Krylov subspace with the initial subspace, complemented by random
+    // vectors
+    if (initial_subspace.cols() > 0 && initial_subspace.rows() != n) {
+        throw std::runtime_error("The initial subspace does not match the size of the matrix.");
+    }
+
+    std::default_random_engine engine(0);
+    std::normal_distribution<double> distribution;
+
+    const int num_initial =
+        std::min<int>({n, static_cast<int>(initial_subspace.cols()), num_eigenvalues + 10});
+    const int block_size = std::min(n, std::max(num_eigenvalues + 10, num_initial));
+    const int max_basis_size = n / 4;
+
+    // Ritz values closer to the bounds of the window than the accuracy of the eigenvalues might
+    // or might not be counted
+    const double band = tolerance * scale;
+
+    dense_t basis(n, 0);
+    dense_t projected(0, 0);
+    dense_t block(n, block_size);
+    if (num_initial > 0) {
+        block.leftCols(num_initial) = initial_subspace.leftCols(num_initial);
+    }
+    for (int col = num_initial; col < block.cols(); ++col) {
+        for (int row = 0; row < block.rows(); ++row) {
+            block(row, col) = distribution(engine);
+        }
+    }
+
+    while (true) {
+        // Extend the Krylov subspace by the orthonormalized block
+        int size_old = basis.cols();
+        int size_block = std::min<int>(block.cols(), n - size_old);
+        if (size_old + size_block > max_basis_size) {
+            return diagonalizeDense();
+        }
+        dense_t new_block = block.leftCols(size_block);
+        orthonormalize(basis, new_block, engine);
+
+        basis.conservativeResize(n, size_old + size_block);
+        basis.rightCols(size_block) = new_block;
+
+        // Project the Hamiltonian onto the extended subspace
+        dense_t hamiltonian_new_block = hamiltonian * new_block;
+        projected.conservativeResize(size_old + size_block, size_old + size_block);
+        projected.rightCols(size_block) = basis.adjoint() * hamiltonian_new_block;
+        projected.bottomLeftCorner(size_block, size_old) =
+            projected.topRightCorner(size_old, size_block).adjoint();
+
+        // Calculate Ritz pairs
+        dense_t projected_hermitian = 0.5 * (projected + dense_t(projected.adjoint()));
+        Eigen::SelfAdjointEigenSolver<dense_t> eigensolver(projected_hermitian);
+
+        // Select the Ritz pairs inside the energy window, widened by the band
+        std::vector<int> indices;
+        int num_inner = 0;
+        for (int idx = 0; idx < eigensolver.eigenvalues().size(); ++idx) {
+            double val = eigensolver.eigenvalues()[idx];
+            if (val >= energy_lower_bound - band && val <= energy_upper_bound + band) {
+                indices.push_back(idx);
+            }
+            if (val >= energy_lower_bound + band && val <= energy_upper_bound - band) {
+                ++num_inner;
+            }
+        }
+
+        dense_t ritz_vectors(n, indices.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            ritz_vectors.col(i) = basis * eigensolver.eigenvectors().col(indices[i]);
+        }
+
+        // Check the residuals of the selected Ritz pairs
+        bool is_converged = true;
+        if (basis.cols() < n) {
+            dense_t residuals = hamiltonian * ritz_vectors;
+            for (size_t i = 0; i < indices.size(); ++i) {
+                residuals.col(i) -= eigensolver.eigenvalues()[indices[i]] * ritz_vectors.col(i);
+                if (residuals.col(i).norm() > tolerance * scale) {
+                    is_converged = false;
+                    break;
+                }
+            }
+        }
+
+        if (basis.cols() == n ||
+            (is_converged && num_inner <= num_eigenvalues &&
+             static_cast<int>(indices.size()) >= num_eigenvalues)) {
+            std::vector<int> columns;
+            for (size_t i = 0; i < indices.size(); ++i) {
+                double val = eigensolver.eigenvalues()[indices[i]];
+                if (val >= energy_lower_bound && val <= energy_upper_bound) {
+                    columns.push_back(i);
+                }
+            }
+            eigenpairs.values.resize(columns.size());
+            eigenpairs.vectors.resize(n, columns.size());
+            for (size_t i = 0; i < columns.size(); ++i) {
+                eigenpairs.values[i] = eigensolver.eigenvalues()[indices[columns[i]]];
+                eigenpairs.vectors.col(i) = ritz_vectors.col(columns[i]);
+            }
+            break;
+        }
+
+        // Apply the inverse of the shifted Hamiltonian to the newest block
+        block = solver.solve(new_block);
+        if (solver.info() != Eigen::Success) {
+            throw std::runtime_error("Solving the shifted linear system failed.");
+        }
+    }
+
+    return eigenpairs;
+}
+
+} // namespace eigensolver
+
+#endif // EIGENSOLVER_H
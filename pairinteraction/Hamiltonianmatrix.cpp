@@ -18,6 +18,7 @@
  */
 
 #include "Hamiltonianmatrix.hpp"
+#include "Eigensolver.hpp"
 #include <stdexcept>
 
 #include <fmt/format.h>
@@ -67,9 +68,14 @@ void Hamiltonianmatrix::compress(size_t nBasis, size_t nCoordinates) {
     triplets_entries.clear();
 }
 
-std::vector<Hamiltonianmatrix> Hamiltonianmatrix::findSubs() const { // TODO
+std::vector<Hamiltonianmatrix> Hamiltonianmatrix::findSubs() const {
+    std::vector<std::vector<int>> blocks = eigensolver::findBlocks(entries_);
+
     std::vector<Hamiltonianmatrix> submatrices;
-    submatrices.push_back(*this);
+    submatrices.reserve(blocks.size());
+    for (const auto &block : blocks) {
+        submatrices.push_back(this->getBlock(std::vector<ptrdiff_t>(block.begin(), block.end())));
+    }
     return submatrices;
 }
 
@@ -207,7 +213,7 @@ void Hamiltonianmatrix::removeUnnecessaryStates(const std::vector<bool> &isNeces
     basis_ = transformator * basis_;
 }
 
-Hamiltonianmatrix Hamiltonianmatrix::getBlock(const std::vector<ptrdiff_t> &indices) {
+Hamiltonianmatrix Hamiltonianmatrix::getBlock(const std::vector<ptrdiff_t> &indices) const {
     std::vector<eigen_triplet_t> triplets_transformator;
     triplets_transformator.reserve(indices.size());
     for (size_t idx = 0; idx < indices.size(); ++idx) {
@@ -59,7 +59,7 @@ public:
     void removeUnnecessaryBasisvectors(const std::vector<bool> &isNecessaryCoordinate);
     void removeUnnecessaryBasisvectors();
     void removeUnnecessaryStates(const std::vector<bool> &isNecessaryCoordinate);
-    Hamiltonianmatrix getBlock(const std::vector<ptrdiff_t> &indices);
+    Hamiltonianmatrix getBlock(const std::vector<ptrdiff_t> &indices) const;
     void diagonalize();
     friend Hamiltonianmatrix operator+(Hamiltonianmatrix lhs, const Hamiltonianmatrix &rhs);
     friend Hamiltonianmatrix operator-(Hamiltonianmatrix lhs, const Hamiltonianmatrix &rhs);
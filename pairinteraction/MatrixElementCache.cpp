@@ -26,13 +26,95 @@
 
 #include <boost/tokenizer.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <optional>
+#include <set>
+#include <shared_mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/// \brief Calculate the values for a list of cache keys in parallel
+///
+/// Exceptions thrown by \p calculate are caught inside the parallel region and the first one is
+/// rethrown afterwards.
+///
+/// \param keys  keys whose values are calculated
+/// \param calculate  callable that returns the value for a key
+/// \returns values in the order of \p keys
+template <typename Key, typename F>
+auto calculateInParallel(const std::vector<Key> &keys, F &&calculate) {
+    std::vector<std::invoke_result_t<F &, const Key &>> values(keys.size());
+    std::exception_ptr exception;
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t idx = 0; idx < keys.size(); ++idx) {
+        try {
+            values[idx] = calculate(keys[idx]);
+        } catch (...) {
+#pragma omp critical(exception)
+            if (!exception) {
+                exception = std::current_exception();
+            }
+        }
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+
+    return values;
+}
+
+size_t sizeOfWavefunction(const std::shared_ptr<const eigen_dense_double_t> &xy) {
+    return xy->size() * sizeof(double);
+}
+
+/// \brief Table of the species names that occur in cache keys
+struct SpeciesTable {
+    std::shared_mutex mutex;
+    std::deque<std::string> names; // a deque keeps references to the names valid
+    std::unordered_map<std::string, uint16_t> indices;
+};
+
+SpeciesTable &getSpeciesTable() {
+    static SpeciesTable table;
+    return table;
+}
+
+/// \brief Check that a quantum number fits into a bit field of a packed key
+uint64_t packField(long value, int bits) {
+    if (value < 0 || value >= (1L << bits)) {
+        throw std::runtime_error("The quantum number " + std::to_string(value) +
+                                 " is out of the range supported by the cache.");
+    }
+    return static_cast<uint64_t>(value);
+}
+
+/// \brief Finalizer of the SplitMix64 generator, used to spread the bits of a packed key
+uint64_t mixBits(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
 
 bool selectionRulesMomentumNew(StateOne const &state1, StateOne const &state2, int q) {
     bool validL = state1.getL() == state2.getL();
@@ -77,44 +159,36 @@ bool selectionRulesMultipoleNew(StateOne const &state1, StateOne const &state2,
 ////////////////////////////////////////////////////////////////////
 
 MatrixElementCache::MatrixElementCache()
-    : defectdbname(""), dbname(""), pid_which_created_db(utils::get_pid()) {}
+    : cache_radial(std::make_unique<decltype(cache_radial)::element_type>()),
+      mutex_cache_radial_missing(std::make_unique<std::mutex>()),
+      mutex_update(std::make_unique<std::mutex>()),
+      angular(std::make_unique<AngularCoefficients>()),
+      cache_wavefunction(std::make_unique<decltype(cache_wavefunction)::element_type>(
+          max_size_cache_wavefunction, sizeOfWavefunction)),
+      counters_radial(std::make_unique<CacheTableCounters>()),
+      counters_wavefunction(std::make_unique<CacheTableCounters>()),
+      defectdbname(""), dbname(""), pid_which_created_db(utils::get_pid()) {}
 
 MatrixElementCache::MatrixElementCache(std::string const &cachedir)
-    : defectdbname(""),
+    : cache_radial(std::make_unique<decltype(cache_radial)::element_type>()),
+      mutex_cache_radial_missing(std::make_unique<std::mutex>()),
+      mutex_update(std::make_unique<std::mutex>()),
+      angular(std::make_unique<AngularCoefficients>()),
+      cache_wavefunction(std::make_unique<decltype(cache_wavefunction)::element_type>(
+          max_size_cache_wavefunction, sizeOfWavefunction)),
+      counters_radial(std::make_unique<CacheTableCounters>()),
+      counters_wavefunction(std::make_unique<CacheTableCounters>()),
+      defectdbname(""),
       dbname((fs::absolute(cachedir) / ("cache_elements_" + version::cache() + ".db")).string()),
-      db(new sqlite::handle(dbname)), stmt(new sqlite::statement(*db)),
       pid_which_created_db(utils::get_pid()) {
 
-    // Speed up database access
-    stmt->exec("PRAGMA synchronous = OFF"); // do not wait on write, hand off to OS and carry on
-    stmt->exec(
-        "PRAGMA journal_mode = MEMORY"); // keep rollback journal in memory during transaction
+    openDatabase();
 
-    // Create cache tables (reduced_momentum_s and reduced_momentum_l need not to be cached since
-    // they are trivial)
-    stmt->exec("create table if not exists cache_radial ("
-               "method int, species text, k integer, n1 integer, l1 integer, j1 double,"
-               "n2 integer, l2 integer, j2 double, value double, primary key (method, species, k, "
-               "n1, l1, j1, n2, l2, j2)) without rowid;");
-
-    stmt->exec(
-        "create table if not exists cache_angular ("
-        "k integer, j1 double, m1 double,"
-        "j2 double, m2 double, value double, primary key (k, j1, m1, j2, m2)) without rowid;");
-
-    stmt->exec(
-        "create table if not exists cache_reduced_commutes_s ("
-        "s double, k integer, l1 integer, j1 double,"
-        "l2 integer, j2 double, value double, primary key (s, k, l1, j1, l2, j2)) without rowid;");
-
-    stmt->exec(
-        "create table if not exists cache_reduced_commutes_l ("
-        "s double, k integer, l1 integer, j1 double,"
-        "l2 integer, j2 double, value double, primary key (s, k, l1, j1, l2, j2)) without rowid;");
-
-    stmt->exec("create table if not exists cache_reduced_multipole ("
-               "k integer, l1 integer,"
-               "l2 integer, value double, primary key (k, l1, l2)) without rowid;");
+    // Open the read-only store if it has been exported to the cache directory
+    auto storename = fs::absolute(cachedir) / ("cache_elements_" + version::cache() + ".bin");
+    if (fs::exists(storename)) {
+        store = std::make_unique<MatrixElementStore>(storename.string());
+    }
 }
 
 void MatrixElementCache::setDefectDB(std::string const &path) {
@@ -123,6 +197,11 @@ void MatrixElementCache::setDefectDB(std::string const &path) {
 
     // Prevent using the cache file to avoid inconsistencies through the user defined database
     dbname = "";
+    writer.reset();
+    store.reset();
+
+    // The wavefunctions depend on the quantum defects
+    cache_wavefunction->clear();
 }
 
 void MatrixElementCache::setMethod(method_t const &m) {
@@ -130,6 +209,100 @@ void MatrixElementCache::setMethod(method_t const &m) {
     method = m;
 }
 
+void MatrixElementCache::setRadialTolerance(double tolerance) {
+    if (tolerance < 0) {
+        throw std::runtime_error("The tolerance of the radial matrix elements must not be "
+                                 "negative.");
+    }
+    // The cached radial matrix elements might have been calculated with a larger tolerance
+    if (tolerance != radial_tolerance) {
+        cache_radial->clear();
+    }
+    radial_tolerance = tolerance;
+}
+
+bool MatrixElementCache::isAdaptive(method_t method_radial) const {
+    // Numerov's method, also as the fallback of the semiclassical method, uses the tolerance
+    return radial_tolerance > 0 && method_radial != WHITTAKER;
+}
+
+void MatrixElementCache::setStore(std::string const &path) {
+    // Open the read-only store of radial matrix elements, an empty path closes the store
+    store.reset();
+    if (!path.empty()) {
+        store = std::make_unique<MatrixElementStore>(path);
+    }
+}
+
+void MatrixElementCache::exportStore(std::string const &path) {
+    std::lock_guard<std::mutex> lock_update(*mutex_update);
+
+    // Collect the radial matrix elements of the store, the database, and the memory (if an
+    // element is contained several times, the first occurrence is kept)
+    std::vector<std::pair<MatrixElementStore::Key, double>> elements;
+
+    if (store) {
+        elements = store->elements();
+    }
+
+    if (!dbname.empty()) {
+        if (pid_which_created_db != static_cast<long>(utils::get_pid())) {
+            openDatabase();
+        }
+
+        // Wait until the calculated elements have been written
+        writer->flush();
+
+        stmt->set("select method, species, k, n1, l1, j1, n2, l2, j2, value from cache_radial;");
+        stmt->prepare();
+        while (stmt->step()) {
+            elements.emplace_back(
+                MatrixElementStore::makeKey(
+                    static_cast<method_t>(stmt->get<int>(0)), stmt->get<std::string>(1),
+                    stmt->get<int>(2), stmt->get<int>(3), stmt->get<int>(4),
+                    stmt->get<double>(5), stmt->get<int>(6), stmt->get<int>(7),
+                    stmt->get<double>(8)),
+                stmt->get<double>(9));
+        }
+        stmt->reset();
+    }
+
+    // Elements from the adaptive integration are not exported, the store only contains the
+    // results of the fixed step
+    for (auto const &entry : cache_radial->copy()) {
+        const auto &key = entry.first;
+        if (isAdaptive(key.getMethod())) {
+            continue;
+        }
+        auto n = key.getN();
+        auto l = key.getL();
+        auto j = key.getJ();
+        elements.emplace_back(MatrixElementStore::makeKey(key.getMethod(), key.getSpecies(),
+                                                          key.getKappa(), n[0], l[0], j[0], n[1],
+                                                          l[1], j[1]),
+                              entry.second);
+    }
+
+    // Close the store while writing, a file cannot be replaced while it is mapped on Windows. The
+    // store is reopened even if the writing fails.
+    std::string storename;
+    if (store) {
+        storename = store->getPath();
+        store.reset();
+    }
+    try {
+        MatrixElementStore::write(path, std::move(elements));
+    } catch (...) {
+        if (!storename.empty()) {
+            store = std::make_unique<MatrixElementStore>(storename);
+        }
+        throw;
+    }
+    if (!storename.empty()) {
+        store = std::make_unique<MatrixElementStore>(storename);
+    }
+}
+
 void MatrixElementCache::loadElectricDipoleDB(std::string const &path, std::string const &species) {
     int kappa_angular = 1;
     float s = 0.5;
@@ -164,13 +337,6 @@ void MatrixElementCache::loadElectricDipoleDB(std::string const &path, std::stri
                 CacheKey_cache_radial(method, species, kappa_angular, n1, n2, l1, l2, j1, j2);
             radial_raw_data.emplace_back(key1, val);
 
-            // Store which expressions are needed for converting the radial matrix element to a
-            // reduced radial matrix element
-            auto key3 = CacheKey_cache_reduced_commutes(s, kappa_angular, l1, l2, j1, j2);
-            cache_reduced_commutes_s_missing.insert(key3);
-            auto key4 = CacheKey_cache_reduced_multipole(kappa_angular, l1, l2);
-            cache_reduced_multipole_missing.insert(key4);
-
         } catch (std::invalid_argument &e) {
             if (!firstline) { // Skip header
                 std::cerr << "WARNING: During loading the electric dipole database, the error '"
@@ -182,20 +348,17 @@ void MatrixElementCache::loadElectricDipoleDB(std::string const &path, std::stri
     }
     ifs.close();
 
-    // Precaculate the expressions
-    this->update();
-
     // Calculate the reduced radial matrix element and save it to the in-memory cache (it's not
     // saved to the sqlite database)
     for (auto const &pair : radial_raw_data) {
         auto key1 = pair.first;
-        auto key3 = CacheKey_cache_reduced_commutes(s, kappa_angular, key1.l[0], key1.l[1],
-                                                    key1.j[0], key1.j[1]);
-        auto key4 = CacheKey_cache_reduced_multipole(kappa_angular, key1.l[0], key1.l[1]);
+        auto l = key1.getL();
+        auto j = key1.getJ();
         double val = pair.second /
-            (key3.sgn * cache_reduced_commutes_s[key3] * key4.sgn * cache_reduced_multipole[key4]);
+            (angular->getReducedCommutesS(s, kappa_angular, l[0], l[1], j[0], j[1]) *
+             angular->getReducedMultipole(kappa_angular, l[0], l[1]));
 
-        cache_radial[key1] = val;
+        cache_radial_loaded.insert_or_assign(key1, val);
     }
 }
 
@@ -204,96 +367,101 @@ void MatrixElementCache::loadElectricDipoleDB(std::string const &path, std::stri
 ////////////////////////////////////////////////////////////////////
 
 MatrixElementCache::CacheKey_cache_radial::CacheKey_cache_radial(method_t method,
-                                                                 std::string species, int kappa,
-                                                                 int n1, int n2, int l1, int l2,
-                                                                 float j1, float j2)
-    : species(std::move(species)), method(method), kappa(kappa) {
-    if ((n1 < n2) || ((n1 == n2) && ((l1 < l2) || ((l1 == l2) && (j1 <= j2))))) {
-        n = {{n1, n2}};
-        l = {{l1, l2}};
-        j = {{j1, j2}};
-    } else {
-        n = {{n2, n1}};
-        l = {{l2, l1}};
-        j = {{j2, j1}};
+                                                                 std::string const &species,
+                                                                 int kappa, int n1, int n2,
+                                                                 int l1, int l2, float j1,
+                                                                 float j2) {
+    if (!((n1 < n2) || ((n1 == n2) && ((l1 < l2) || ((l1 == l2) && (j1 <= j2)))))) {
+        std::swap(n1, n2);
+        std::swap(l1, l2);
+        std::swap(j1, j2);
     }
-}
 
-MatrixElementCache::CacheKey_cache_angular::CacheKey_cache_angular(int kappa, float j1, float j2,
-                                                                   float m1, float m2)
-    : kappa(kappa) {
-    if ((j1 < j2) || ((j1 == j2) && (m1 <= m2))) {
-        j = {{j1, j2}};
-        m = {{m1, m2}};
-        sgn = 1;
-    } else {
-        j = {{j2, j1}};
-        m = {{m2, m1}};
-        sgn = pow(-1, int(j1 - m1 + j2 - m2));
-    }
+    // Bit layout: high = method (8) | species (16) | kappa (8) | n1 (16) | n2 (16),
+    // low = l1 (16) | l2 (16) | 2*j1 (16) | 2*j2 (16)
+    high = packField(method, 8) << 56 | uint64_t(getSpeciesIndex(species)) << 40 |
+        packField(kappa, 8) << 32 | packField(n1, 16) << 16 | packField(n2, 16);
+    low = packField(l1, 16) << 48 | packField(l2, 16) << 32 |
+        packField(std::lround(2 * j1), 16) << 16 | packField(std::lround(2 * j2), 16);
 }
 
-MatrixElementCache::CacheKey_cache_reduced_commutes::CacheKey_cache_reduced_commutes(
-    float s, int kappa, int l1, int l2, float j1, float j2)
-    : s(s), kappa(kappa) {
-    if ((l1 < l2) || ((l1 == l2) && (j1 <= j2))) {
-        l = {{l1, l2}};
-        j = {{j1, j2}};
-        sgn = 1;
-    } else {
-        l = {{l2, l1}};
-        j = {{j2, j1}};
-        sgn = pow(-1, int(l1 + j1 + l2 + j2 + 2 * s)); // TODO is this formula always correct?
-    }
+MatrixElementCache::CacheKey_cache_radial::CacheKey_cache_radial() =
+    default; // TODO the default constructors seem to be needed for serialization, can one somehow
+             // circumvent the need of default constructors?
+
+bool MatrixElementCache::CacheKey_cache_radial::operator==(const CacheKey_cache_radial &rhs) const {
+    return high == rhs.high && low == rhs.low;
 }
 
-MatrixElementCache::CacheKey_cache_reduced_multipole::CacheKey_cache_reduced_multipole(int kappa,
-                                                                                       int l1,
-                                                                                       int l2)
-    : kappa(kappa) {
-    if (l1 <= l2) {
-        l = {{l1, l2}};
-        sgn = 1;
-    } else {
-        l = {{l2, l1}};
-        sgn = pow(-1, kappa);
-    }
+method_t MatrixElementCache::CacheKey_cache_radial::getMethod() const {
+    return static_cast<method_t>(high >> 56);
 }
 
-MatrixElementCache::CacheKey_cache_radial::CacheKey_cache_radial() =
-    default; // TODO the default constructors seem to be needed for serialization, can one somehow
-             // circumvent the need of default constructors?
+const std::string &MatrixElementCache::CacheKey_cache_radial::getSpecies() const {
+    return getSpeciesName((high >> 40) & 0xffff);
+}
 
-MatrixElementCache::CacheKey_cache_angular::CacheKey_cache_angular() =
-    default; // TODO the default constructors seem to be needed for serialization, can one somehow
-             // circumvent the need of default constructors?
+int MatrixElementCache::CacheKey_cache_radial::getKappa() const { return (high >> 32) & 0xff; }
 
-MatrixElementCache::CacheKey_cache_reduced_commutes::CacheKey_cache_reduced_commutes() =
-    default; // TODO the default constructors seem to be needed for serialization, can one somehow
-             // circumvent the need of default constructors?
+std::array<int, 2> MatrixElementCache::CacheKey_cache_radial::getN() const {
+    return {{int((high >> 16) & 0xffff), int(high & 0xffff)}};
+}
 
-MatrixElementCache::CacheKey_cache_reduced_multipole::CacheKey_cache_reduced_multipole() =
-    default; // TODO the default constructors seem to be needed for serialization, can one somehow
-             // circumvent the need of default constructors?
+std::array<int, 2> MatrixElementCache::CacheKey_cache_radial::getL() const {
+    return {{int((low >> 48) & 0xffff), int((low >> 32) & 0xffff)}};
+}
 
-bool MatrixElementCache::CacheKey_cache_radial::operator==(const CacheKey_cache_radial &rhs) const {
-    return (method == rhs.method) && (species == rhs.species) && (kappa == rhs.kappa) &&
-        (n == rhs.n) && (l == rhs.l) && (j == rhs.j);
+std::array<float, 2> MatrixElementCache::CacheKey_cache_radial::getJ() const {
+    return {{((low >> 16) & 0xffff) / 2.f, (low & 0xffff) / 2.f}};
 }
 
-bool MatrixElementCache::CacheKey_cache_angular::operator==(
-    const CacheKey_cache_angular &rhs) const {
-    return (kappa == rhs.kappa) && (j == rhs.j) && (m == rhs.m);
+uint16_t MatrixElementCache::getSpeciesIndex(std::string const &species) {
+    // Usually, all states have the same species, thus the last index is remembered by each thread
+    thread_local std::string last_species;
+    thread_local uint16_t last_index = 0;
+    if (!last_species.empty() && species == last_species) {
+        return last_index;
+    }
+
+    auto &table = getSpeciesTable();
+    std::optional<uint16_t> index;
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        auto it = table.indices.find(species);
+        if (it != table.indices.end()) {
+            index = it->second;
+        }
+    }
+    if (!index) {
+        std::unique_lock<std::shared_mutex> lock(table.mutex);
+        auto it = table.indices.find(species);
+        if (it != table.indices.end()) {
+            index = it->second;
+        } else {
+            if (table.names.size() > std::numeric_limits<uint16_t>::max()) {
+                throw std::runtime_error("Too many species are used by the cache.");
+            }
+            index = table.names.size();
+            table.names.push_back(species);
+            table.indices.emplace(species, index.value());
+        }
+    }
+
+    last_species = species;
+    last_index = index.value();
+    return last_index;
 }
 
-bool MatrixElementCache::CacheKey_cache_reduced_commutes::operator==(
-    const CacheKey_cache_reduced_commutes &rhs) const {
-    return (s == rhs.s) && (kappa == rhs.kappa) && (l == rhs.l) && (j == rhs.j);
+const std::string &MatrixElementCache::getSpeciesName(uint16_t index) {
+    auto &table = getSpeciesTable();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    return table.names[index];
 }
 
-bool MatrixElementCache::CacheKey_cache_reduced_multipole::operator==(
-    const CacheKey_cache_reduced_multipole &rhs) const {
-    return (kappa == rhs.kappa) && (l == rhs.l);
+bool MatrixElementCache::CacheKey_cache_wavefunction::operator==(
+    const CacheKey_cache_wavefunction &rhs) const {
+    return method == rhs.method && species == rhs.species && n == rhs.n && l == rhs.l &&
+        j == rhs.j && stride == rhs.stride;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -302,40 +470,18 @@ bool MatrixElementCache::CacheKey_cache_reduced_multipole::operator==(
 
 std::size_t
 MatrixElementCache::CacheKeyHasher_cache_radial::operator()(const CacheKey_cache_radial &c) const {
+    return mixBits(c.low ^ mixBits(c.high));
+}
+
+std::size_t MatrixElementCache::CacheKeyHasher_cache_wavefunction::operator()(
+    const CacheKey_cache_wavefunction &c) const {
     size_t seed = 0;
     utils::hash_combine(seed, c.method);
     utils::hash_combine(seed, c.species);
-    utils::hash_combine(seed, c.kappa);
     utils::hash_combine(seed, c.n);
     utils::hash_combine(seed, c.l);
     utils::hash_combine(seed, c.j);
-    return seed;
-}
-
-std::size_t MatrixElementCache::CacheKeyHasher_cache_angular::operator()(
-    const CacheKey_cache_angular &c) const {
-    size_t seed = 0;
-    utils::hash_combine(seed, c.kappa);
-    utils::hash_combine(seed, c.j);
-    utils::hash_combine(seed, c.m);
-    return seed;
-}
-
-std::size_t MatrixElementCache::CacheKeyHasher_cache_reduced_commutes::operator()(
-    const CacheKey_cache_reduced_commutes &c) const {
-    size_t seed = 0;
-    utils::hash_combine(seed, c.s);
-    utils::hash_combine(seed, c.kappa);
-    utils::hash_combine(seed, c.l);
-    utils::hash_combine(seed, c.j);
-    return seed;
-}
-
-std::size_t MatrixElementCache::CacheKeyHasher_cache_reduced_multipole::operator()(
-    const CacheKey_cache_reduced_multipole &c) const {
-    size_t seed = 0;
-    utils::hash_combine(seed, c.kappa);
-    utils::hash_combine(seed, c.l);
+    utils::hash_combine(seed, c.stride);
     return seed;
 }
 
@@ -369,44 +515,20 @@ double MatrixElementCache::getMagneticDipole(StateOne const &state_row, StateOne
     auto key1 = CacheKey_cache_radial(method, species, 0, state_row.getN(), state_col.getN(),
                                       state_row.getL(), state_col.getL(), state_row.getJ(),
                                       state_col.getJ());
-    auto iter1 = cache_radial.find(key1);
-    if (iter1 == cache_radial.end()) {
-        cache_radial_missing.insert(key1);
-    }
-
-    auto key2 = CacheKey_cache_angular(1, state_row.getJ(), state_col.getJ(), state_row.getM(),
-                                       state_col.getM());
-    auto iter2 = cache_angular.find(key2);
-    if (iter2 == cache_angular.end()) {
-        cache_angular_missing.insert(key2);
-    }
-
-    auto key3 = CacheKey_cache_reduced_commutes(s, 1, state_row.getL(), state_col.getL(),
-                                                state_row.getJ(), state_col.getJ());
-    auto iter3 = cache_reduced_commutes_s.find(key3);
-    if (iter3 == cache_reduced_commutes_s.end()) {
-        cache_reduced_commutes_s_missing.insert(key3);
-    }
-
-    auto key4 = CacheKey_cache_reduced_commutes(s, 1, state_row.getL(), state_col.getL(),
-                                                state_row.getJ(), state_col.getJ());
-    auto iter4 = cache_reduced_commutes_l.find(key4);
-    if (iter4 == cache_reduced_commutes_l.end()) {
-        cache_reduced_commutes_l_missing.insert(key4);
-    }
-
-    // Update cache by calculate missing constituents
-    if (this->update() != 0) {
-        iter1 = cache_radial.find(key1);
-        iter2 = cache_angular.find(key2);
-        iter3 = cache_reduced_commutes_s.find(key3);
-        iter4 = cache_reduced_commutes_l.find(key4);
-    }
-
-    return -bohr_magneton * iter1->second * key2.sgn * iter2->second *
-        (gL * key3.sgn * iter3->second *
+    double radial = getRadialElement(key1);
+
+    // Calculate the angular parts
+    double angular2 = angular->getAngular(1, state_row.getJ(), state_col.getJ(), state_row.getM(),
+                                          state_col.getM());
+    double angular3 = angular->getReducedCommutesS(s, 1, state_row.getL(), state_col.getL(),
+                                                   state_row.getJ(), state_col.getJ());
+    double angular4 = angular->getReducedCommutesL(s, 1, state_row.getL(), state_col.getL(),
+                                                   state_row.getJ(), state_col.getJ());
+
+    return -bohr_magneton * radial * angular2 *
+        (gL * angular3 *
              sqrt(state_row.getL() * (state_row.getL() + 1) * (2 * state_row.getL() + 1)) +
-         gS * key4.sgn * iter4->second * sqrt(s * (s + 1) * (2 * s + 1)));
+         gS * angular4 * sqrt(s * (s + 1) * (2 * s + 1)));
 }
 
 double MatrixElementCache::getElectricMultipole(StateOne const &state_row,
@@ -423,41 +545,17 @@ double MatrixElementCache::getElectricMultipole(StateOne const &state_row,
     auto key1 = CacheKey_cache_radial(method, species, kappa_radial, state_row.getN(),
                                       state_col.getN(), state_row.getL(), state_col.getL(),
                                       state_row.getJ(), state_col.getJ());
-    auto iter1 = cache_radial.find(key1);
-    if (iter1 == cache_radial.end()) {
-        cache_radial_missing.insert(key1);
-    }
+    double radial = getRadialElement(key1);
 
-    auto key2 = CacheKey_cache_angular(kappa_angular, state_row.getJ(), state_col.getJ(),
-                                       state_row.getM(), state_col.getM());
-    auto iter2 = cache_angular.find(key2);
-    if (iter2 == cache_angular.end()) {
-        cache_angular_missing.insert(key2);
-    }
-
-    auto key3 = CacheKey_cache_reduced_commutes(
+    // Calculate the angular parts
+    double angular2 = angular->getAngular(kappa_angular, state_row.getJ(), state_col.getJ(),
+                                          state_row.getM(), state_col.getM());
+    double angular3 = angular->getReducedCommutesS(
         s, kappa_angular, state_row.getL(), state_col.getL(), state_row.getJ(), state_col.getJ());
-    auto iter3 = cache_reduced_commutes_s.find(key3);
-    if (iter3 == cache_reduced_commutes_s.end()) {
-        cache_reduced_commutes_s_missing.insert(key3);
-    }
+    double angular4 =
+        angular->getReducedMultipole(kappa_angular, state_row.getL(), state_col.getL());
 
-    auto key4 = CacheKey_cache_reduced_multipole(kappa_angular, state_row.getL(), state_col.getL());
-    auto iter4 = cache_reduced_multipole.find(key4);
-    if (iter4 == cache_reduced_multipole.end()) {
-        cache_reduced_multipole_missing.insert(key4);
-    }
-
-    // Update cache by calculate missing constituents
-    if (this->update() != 0) {
-        iter1 = cache_radial.find(key1);
-        iter2 = cache_angular.find(key2);
-        iter3 = cache_reduced_commutes_s.find(key3);
-        iter4 = cache_reduced_multipole.find(key4);
-    }
-
-    return elementary_charge * iter1->second * key2.sgn * iter2->second * key3.sgn * iter3->second *
-        key4.sgn * iter4->second;
+    return elementary_charge * radial * angular2 * angular3 * angular4;
 }
 
 double MatrixElementCache::getRadial(StateOne const &state_row, StateOne const &state_col,
@@ -472,19 +570,7 @@ double MatrixElementCache::getRadial(StateOne const &state_row, StateOne const &
     auto key1 = CacheKey_cache_radial(method, species, kappa, state_row.getN(), state_col.getN(),
                                       state_row.getL(), state_col.getL(), state_row.getJ(),
                                       state_col.getJ());
-    auto iter1 = cache_radial.find(key1);
-    if (iter1 == cache_radial.end()) {
-        cache_radial_missing.insert(key1);
-    }
-
-    // Update cache by calculate missing constituents
-    if (this->update() != 0) {
-        if (iter1 == cache_radial.end()) {
-            iter1 = cache_radial.find(key1);
-        }
-    }
-
-    return iter1->second;
+    return getRadialElement(key1);
 }
 
 const std::string &MatrixElementCache::getDefectDB() const { return defectdbname; }
@@ -521,22 +607,332 @@ void MatrixElementCache::precalculateDiamagnetism(const std::vector<StateOne> &b
     precalculate(basis_one, k, q, 2, true, false, false);
 }
 
+size_t MatrixElementCache::warm(std::string const &species, std::array<int, 2> const &n_range,
+                                int l_max, std::vector<int> const &kappas, method_t method_warm) {
+    if (species.empty() || n_range[0] < 1 || n_range[1] < n_range[0] || l_max < 0 ||
+        std::any_of(kappas.begin(), kappas.end(), [](int kappa) { return kappa < 0; })) {
+        throw std::runtime_error("The quantum numbers for warming the cache are invalid.");
+    }
+
+    float s = 0.5;
+    if (std::isdigit(species.back()) != 0) {
+        s = ((species.back() - '0') - 1) / 2.;
+    }
+
+    // --- Determine the states ---
+
+    struct Orbital {
+        int n, l;
+        float j;
+    };
+    std::vector<Orbital> orbitals;
+    for (int n = n_range[0]; n <= n_range[1]; ++n) {
+        for (int l = 0; l <= std::min(l_max, n - 1); ++l) {
+            for (float j = std::fabs(l - s); j <= l + s; ++j) {
+                orbitals.push_back({n, l, j});
+            }
+        }
+    }
+
+    auto coupled = [](int kappa, const Orbital &o1, const Orbital &o2) {
+        return std::abs(o1.l - o2.l) <= kappa && (o1.l + o2.l + kappa) % 2 == 0;
+    };
+
+    // --- Calculate the angular coefficients ---
+
+    // They only depend on l and j, thus the states of a single principal quantum number suffice
+    std::vector<Orbital> orbitals_of_n;
+    std::copy_if(orbitals.begin(), orbitals.end(), std::back_inserter(orbitals_of_n),
+                 [&](const Orbital &o) { return o.n == n_range[1]; });
+    for (int kappa : kappas) {
+        for (auto const &o1 : orbitals_of_n) {
+            for (auto const &o2 : orbitals_of_n) {
+                if (coupled(kappa, o1, o2)) {
+                    angular->getAngular(kappa, o1.j, o2.j, o1.j, o2.j);
+                    angular->getReducedMultipole(kappa, o1.l, o2.l);
+                    angular->getReducedCommutesS(s, kappa, o1.l, o2.l, o1.j, o2.j);
+                    angular->getReducedCommutesL(s, kappa, o1.l, o2.l, o1.j, o2.j);
+                }
+            }
+        }
+    }
+
+    // --- Calculate the radial matrix elements ---
+
+    // The elements are calculated in batches of a fixed smaller principal quantum number so that
+    // the set of missing elements stays small
+    size_t num_missing = 0;
+    size_t num_hits = 0;
+    for (int n1 = n_range[0]; n1 <= n_range[1]; ++n1) {
+        std::unordered_set<CacheKey_cache_radial, CacheKeyHasher_cache_radial> missing;
+        for (auto const &o1 : orbitals) {
+            if (o1.n != n1) {
+                continue;
+            }
+            for (auto const &o2 : orbitals) {
+                if (o2.n < n1) {
+                    continue;
+                }
+                for (int kappa : kappas) {
+                    if (!coupled(kappa, o1, o2)) {
+                        continue;
+                    }
+                    auto key = CacheKey_cache_radial(method_warm, species, kappa, o1.n, o2.n,
+                                                     o1.l, o2.l, o1.j, o2.j);
+                    if (cache_radial_loaded.count(key) == 0 && !cache_radial->restore(key)) {
+                        missing.insert(key);
+                    } else {
+                        ++num_hits;
+                    }
+                }
+            }
+        }
+
+        num_missing += missing.size();
+        CacheTableCounters::add(counters_radial->local().misses, missing.size());
+        {
+            std::lock_guard<std::mutex> lock(*mutex_cache_radial_missing);
+            cache_radial_missing.insert(missing.begin(), missing.end());
+        }
+        this->update();
+    }
+    CacheTableCounters::add(counters_radial->local().hits, num_hits);
+
+    // --- Wait until the elements have been written to the database ---
+
+    if (!dbname.empty()) {
+        std::lock_guard<std::mutex> lock_update(*mutex_update);
+        if (pid_which_created_db != static_cast<long>(utils::get_pid())) {
+            openDatabase();
+        }
+        writer->flush();
+    }
+
+    return num_missing;
+}
+
 ////////////////////////////////////////////////////////////////////
 /// Utility methods ////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////
 
-double MatrixElementCache::calcRadialElement(const QuantumDefect &qd1, int power,
-                                             const QuantumDefect &qd2) {
-    if (method == NUMEROV) {
-        return std::pow(au2um, power) * IntegrateRadialElement<Numerov>(qd1, power, qd2);
+double MatrixElementCache::getRadialElement(const CacheKey_cache_radial &key) {
+    if (!cache_radial_loaded.empty()) {
+        auto it = cache_radial_loaded.find(key);
+        if (it != cache_radial_loaded.end()) {
+            CacheTableCounters::add(counters_radial->local().hits);
+            return it->second;
+        }
+    }
+
+    if (auto cached = cache_radial->restore(key)) {
+        CacheTableCounters::add(counters_radial->local().hits);
+        return cached.value();
+    }
+    CacheTableCounters::add(counters_radial->local().misses);
+
+    // Calculate the missing element together with the elements that other threads have reported
+    // as missing. The value is returned by updateRadial because, if the memory limit is small, the
+    // element might be evicted by other threads before it could be restored from the cache.
+    std::lock_guard<std::mutex> lock_update(*mutex_update);
+    std::unordered_map<CacheKey_cache_radial, double, CacheKeyHasher_cache_radial> requested{
+        {key, 0}};
+    this->updateRadial(requested);
+    return requested.at(key);
+}
+
+template <typename T>
+std::shared_ptr<const eigen_dense_double_t>
+MatrixElementCache::getWavefunction(method_t method, const QuantumDefect &qd, int stride) {
+    CacheKey_cache_wavefunction key{method, qd.species, qd.n, qd.l, qd.j, stride};
+    if (auto cached = cache_wavefunction->restore(key)) {
+        CacheTableCounters::add(counters_wavefunction->local().hits);
+        return cached.value();
+    }
+    CacheTableCounters::add(counters_wavefunction->local().misses);
+
+    std::shared_ptr<const eigen_dense_double_t> xy;
+    {
+        CacheTableTimer timer(counters_wavefunction->local().calculation_nanoseconds);
+        if constexpr (std::is_same_v<T, Numerov>) {
+            T wavefunction(qd, stride);
+            xy = std::make_shared<const eigen_dense_double_t>(wavefunction.integrate());
+        } else {
+            T wavefunction(qd);
+            xy = std::make_shared<const eigen_dense_double_t>(wavefunction.integrate());
+        }
+    }
+    CacheTableCounters::add(counters_wavefunction->local().calculations);
+    cache_wavefunction->save(key, xy);
+    return xy;
+}
+
+void MatrixElementCache::precalculateWavefunctions(
+    const std::vector<CacheKey_cache_radial> &keys) {
+    // Collect the states whose wavefunctions for Numerov's method are missing. Only as many
+    // wavefunctions are calculated in advance as fit into half of the cache of wavefunctions, so
+    // that they are not evicted before they are used. The others are calculated when needed. If a
+    // tolerance is set, the wavefunctions for the coarsest step are calculated. The semiclassical
+    // method needs the wavefunctions only for the elements it cannot approximate.
+    int const stride = radial_tolerance > 0 ? max_stride_radial : 1;
+    std::deque<QuantumDefect> qds; // a deque keeps references to the quantum defects valid
+    std::set<std::tuple<std::string, int, int, float>> states;
+    size_t const capacity = cache_wavefunction->get_capacity() / 2;
+    size_t bytes = 0;
+    for (const auto &key : keys) {
+        if (key.getMethod() != NUMEROV && key.getMethod() != SEMICLASSICAL) {
+            continue;
+        }
+        auto n = key.getN();
+        auto l = key.getL();
+        auto j = key.getJ();
+        if (key.getMethod() == SEMICLASSICAL) {
+            QuantumDefect qd1(key.getSpecies(), n[0], l[0], j[0], defectdbname);
+            QuantumDefect qd2(key.getSpecies(), n[1], l[1], j[1], defectdbname);
+            if (semiclassical::IsValid(qd1, key.getKappa(), qd2)) {
+                continue;
+            }
+        }
+        for (size_t idx = 0; idx < 2 && bytes <= capacity; ++idx) {
+            if (!states.emplace(key.getSpecies(), n[idx], l[idx], j[idx]).second) {
+                continue;
+            }
+            qds.emplace_back(key.getSpecies(), n[idx], l[idx], j[idx], defectdbname);
+            const auto &qd = qds.back();
+            if (cache_wavefunction->restore({NUMEROV, qd.species, qd.n, qd.l, qd.j, stride})) {
+                qds.pop_back();
+                continue;
+            }
+            bytes += 2 * Numerov::getNumberOfSteps(qd, stride) * sizeof(double);
+            if (bytes > capacity) {
+                qds.pop_back();
+            }
+        }
+    }
+    if (qds.empty()) {
+        return;
+    }
+
+    // Integrate the wavefunctions in batches of states that share the model potential
+    CacheTableCounters::add(counters_wavefunction->local().misses, qds.size());
+    CacheTableCounters::add(counters_wavefunction->local().calculations, qds.size());
+
+    std::vector<const QuantumDefect *> pointers;
+    for (const auto &qd : qds) {
+        pointers.push_back(&qd);
+    }
+    auto batches = Numerov::makeBatches(pointers);
+
+    calculateInParallel(batches, [&](const std::vector<size_t> &batch) {
+        // The time is summed over the threads. The wavefunctions are integrated for calculating
+        // radial matrix elements, so that the time is added to their calculation time as well.
+        CacheTableTimer timer(counters_wavefunction->local().calculation_nanoseconds);
+        CacheTableTimer timer_radial(counters_radial->local().calculation_nanoseconds);
+        std::vector<const QuantumDefect *> batch_qds;
+        for (size_t idx : batch) {
+            batch_qds.push_back(pointers[idx]);
+        }
+        auto xys = Numerov::integrate(batch_qds, stride);
+        for (size_t idx = 0; idx < batch.size(); ++idx) {
+            const auto &qd = *batch_qds[idx];
+            cache_wavefunction->save({NUMEROV, qd.species, qd.n, qd.l, qd.j, stride},
+                                     std::make_shared<const eigen_dense_double_t>(
+                                         std::move(xys[idx])));
+        }
+        return batch.size();
+    });
+}
+
+std::vector<double> MatrixElementCache::calcRadialElements(method_t method,
+                                                           const QuantumDefect &qd1,
+                                                           const std::vector<int> &powers,
+                                                           const QuantumDefect &qd2) {
+    std::vector<double> values;
+    if (method == NUMEROV && radial_tolerance > 0) {
+        values = calcRadialElementsAdaptive(qd1, powers, qd2);
+    } else if (method == NUMEROV) {
+        values = IntegrateRadialElements<Numerov>(*getWavefunction<Numerov>(method, qd1), powers,
+                                                  *getWavefunction<Numerov>(method, qd2));
+    } else if (method == WHITTAKER) {
+        values = IntegrateRadialElements<Whittaker>(*getWavefunction<Whittaker>(method, qd1),
+                                                    powers,
+                                                    *getWavefunction<Whittaker>(method, qd2));
+    } else if (method == SEMICLASSICAL) {
+        // Fall back to Numerov's method for the elements that cannot be approximated
+        std::vector<int> powers_numerov;
+        for (int power : powers) {
+            if (!semiclassical::IsValid(qd1, power, qd2)) {
+                powers_numerov.push_back(power);
+            }
+        }
+        std::vector<double> values_numerov;
+        if (!powers_numerov.empty()) {
+            values_numerov = calcRadialElements(NUMEROV, qd1, powers_numerov, qd2);
+        }
+
+        auto it = values_numerov.begin();
+        for (int power : powers) {
+            if (semiclassical::IsValid(qd1, power, qd2)) {
+                values.push_back(semiclassical::RadialDipoleElement(qd1, qd2) *
+                                 std::pow(au2um, power));
+            } else {
+                values.push_back(*it++);
+            }
+        }
+        return values;
+    } else {
+        std::string msg(
+            "You have to provide all radial matrix elements on your own because you have "
+            "deactivated the calculation of missing radial matrix elements!");
+        std::cout << msg << std::endl;
+        throw std::runtime_error(msg);
+    }
+
+    for (size_t idx = 0; idx < powers.size(); ++idx) {
+        values[idx] *= std::pow(au2um, powers[idx]);
     }
-    if (method == WHITTAKER) {
-        return std::pow(au2um, power) * IntegrateRadialElement<Whittaker>(qd1, power, qd2);
+    return values;
+}
+
+std::vector<double> MatrixElementCache::calcRadialElementsAdaptive(
+    const QuantumDefect &qd1, const std::vector<int> &powers, const QuantumDefect &qd2) {
+    auto integrate = [&](int stride) {
+        return IntegrateRadialElements<Numerov>(*getWavefunction<Numerov>(NUMEROV, qd1, stride),
+                                                powers,
+                                                *getWavefunction<Numerov>(NUMEROV, qd2, stride),
+                                                stride);
+    };
+
+    // The error of Numerov's method scales with the fourth power of the step, so that the results
+    // for two steps are improved by Richardson extrapolation. The error of the extrapolated
+    // results is estimated by their difference to the extrapolated results for the previous,
+    // twice as large steps. The elements are compared to n^(2*kappa), the order of magnitude of
+    // the largest elements between states of the principal quantum number n.
+    double const n = std::max(qd1.n, qd2.n);
+    std::vector<double> coarse = integrate(max_stride_radial);
+    std::vector<double> extrapolated;
+    for (int stride = max_stride_radial / 2; stride >= 1; stride /= 2) {
+        std::vector<double> fine = integrate(stride);
+        if (stride == 1) {
+            return fine;
+        }
+
+        std::vector<double> current(powers.size());
+        bool converged = !extrapolated.empty();
+        for (size_t idx = 0; idx < powers.size(); ++idx) {
+            current[idx] = fine[idx] + (fine[idx] - coarse[idx]) / 15;
+            if (!extrapolated.empty()) {
+                double scale = std::max(std::abs(current[idx]), std::pow(n, 2 * powers[idx]));
+                converged = converged &&
+                    std::abs(current[idx] - extrapolated[idx]) <= radial_tolerance * scale;
+            }
+        }
+        if (converged) {
+            return current;
+        }
+        extrapolated = std::move(current);
+        coarse = std::move(fine);
     }
-    std::string msg("You have to provide all radial matrix elements on your own because you have "
-                    "deactivated the calculation of missing radial matrix elements!");
-    std::cout << msg << std::endl;
-    throw std::runtime_error(msg);
+    return coarse;
 }
 
 void MatrixElementCache::precalculate(const std::vector<StateOne> &basis_one, int kappa_angular,
@@ -544,7 +940,8 @@ void MatrixElementCache::precalculate(const std::vector<StateOne> &basis_one, in
                                       bool calcMagneticMomentum, bool calcRadial) {
 
     std::string species;
-    float s = std::numeric_limits<float>::max();
+    std::vector<CacheKey_cache_radial> missing;
+    size_t num_hits = 0;
 
     // --- Determine elements ---
 
@@ -556,7 +953,6 @@ void MatrixElementCache::precalculate(const std::vector<StateOne> &basis_one, in
 
         if (species.empty()) {
             species = state_col.getSpecies();
-            s = state_col.getS();
         }
 
         for (size_t idx_row = 0; idx_row <= idx_col; ++idx_row) {
@@ -577,118 +973,126 @@ void MatrixElementCache::precalculate(const std::vector<StateOne> &basis_one, in
                     auto key = CacheKey_cache_radial(
                         method, species, kappa_radial, state_row.getN(), state_col.getN(),
                         state_row.getL(), state_col.getL(), state_row.getJ(), state_col.getJ());
-                    if (cache_radial.find(key) == cache_radial.end()) {
-                        cache_radial_missing.insert(key);
+                    if (cache_radial_loaded.count(key) == 0 && !cache_radial->restore(key)) {
+                        missing.push_back(key);
+                    } else {
+                        ++num_hits;
                     }
                 }
+            }
+        }
+    }
 
-                if (calcElectricMultipole || calcMagneticMomentum) {
-                    auto key =
-                        CacheKey_cache_angular(kappa_angular, state_row.getJ(), state_col.getJ(),
-                                               state_row.getM(), state_col.getM());
-                    if (cache_angular.find(key) == cache_angular.end()) {
-                        cache_angular_missing.insert(key);
-                    }
-                }
+    CacheTableCounters::add(counters_radial->local().hits, num_hits);
+    CacheTableCounters::add(counters_radial->local().misses, missing.size());
 
-                if (calcElectricMultipole || calcMagneticMomentum) {
-                    auto key = CacheKey_cache_reduced_commutes(s, kappa_angular, state_row.getL(),
-                                                               state_col.getL(), state_row.getJ(),
-                                                               state_col.getJ());
-                    if (cache_reduced_commutes_s.find(key) == cache_reduced_commutes_s.end()) {
-                        cache_reduced_commutes_s_missing.insert(key);
-                    }
-                }
+    std::lock_guard<std::mutex> lock(*mutex_cache_radial_missing);
+    cache_radial_missing.insert(missing.begin(), missing.end());
+}
 
-                if (calcMagneticMomentum) {
-                    auto key = CacheKey_cache_reduced_commutes(s, kappa_angular, state_row.getL(),
-                                                               state_col.getL(), state_row.getJ(),
-                                                               state_col.getJ());
-                    if (cache_reduced_commutes_l.find(key) == cache_reduced_commutes_l.end()) {
-                        cache_reduced_commutes_l_missing.insert(key);
-                    }
-                }
+int MatrixElementCache::update() {
+    std::lock_guard<std::mutex> lock_update(*mutex_update);
+    std::unordered_map<CacheKey_cache_radial, double, CacheKeyHasher_cache_radial> requested;
+    return this->updateRadial(requested);
+}
 
-                if (calcElectricMultipole) {
-                    auto key = CacheKey_cache_reduced_multipole(kappa_angular, state_row.getL(),
-                                                                state_col.getL());
-                    if (cache_reduced_multipole.find(key) == cache_reduced_multipole.end()) {
-                        cache_reduced_multipole_missing.insert(key);
-                    }
-                }
+int MatrixElementCache::updateRadial(
+    std::unordered_map<CacheKey_cache_radial, double, CacheKeyHasher_cache_radial> &requested) {
+    // --- Take the elements that are missing ---
+    // Other threads can add further missing elements in the meantime, they are calculated by the
+    // next call of update()
+    std::unordered_set<CacheKey_cache_radial, CacheKeyHasher_cache_radial> missing;
+    {
+        std::lock_guard<std::mutex> lock(*mutex_cache_radial_missing);
+        missing.swap(cache_radial_missing);
+    }
+    for (const auto &entry : requested) {
+        missing.insert(entry.first);
+    }
+
+    // Save an element to the cache and pass its value to the caller if it has been requested
+    auto save = [&](const CacheKey_cache_radial &key, double value) {
+        cache_radial->save(key, value);
+        auto it = requested.find(key);
+        if (it != requested.end()) {
+            it->second = value;
+        }
+    };
+
+    // Skip elements that have been calculated by a previous call of update() since they were
+    // reported as missing
+    for (auto cached = missing.begin(); cached != missing.end();) {
+        if (auto value = cache_radial->restore(*cached)) {
+            auto it = requested.find(*cached);
+            if (it != requested.end()) {
+                it->second = value.value();
             }
+            cached = missing.erase(cached);
+        } else {
+            ++cached;
         }
     }
-}
-
-int MatrixElementCache::update() {
 
     // --- Return if the cache is already up-to-date ---
-    if (cache_radial_missing.empty() && cache_angular_missing.empty() &&
-        cache_reduced_commutes_s_missing.empty() && cache_reduced_commutes_l_missing.empty() &&
-        cache_reduced_multipole_missing.empty()) {
+    if (missing.empty()) {
         return 0;
     }
 
-    // --- Load from database ---
-    if (!dbname.empty()) {
-
-        // Reopen the connection to the database if it was opend by a different process (without
-        // doing this, there can be problems with Python multiprocessing)
-        if (pid_which_created_db != static_cast<long>(utils::get_pid())) {
-            db = std::make_unique<sqlite::handle>(dbname);
-            stmt = std::make_unique<sqlite::statement>(*db);
-            pid_which_created_db = utils::get_pid();
+    // Reopen the connection to the database if it was opend by a different process (without doing
+    // this, there can be problems with Python multiprocessing)
+    if (!dbname.empty() && pid_which_created_db != static_cast<long>(utils::get_pid())) {
+        openDatabase();
+    }
 
-            // Speed up database access
-            stmt->exec(
-                "PRAGMA synchronous = OFF"); // do not wait on write, hand off to OS and carry on
-            stmt->exec("PRAGMA journal_mode = MEMORY"); // keep rollback journal in memory during
-                                                        // transaction
+    // --- Load from the read-only store ---
+    if (store) {
+        CacheTableTimer timer(counters_radial->local().store_nanoseconds);
+        for (auto cached = missing.begin(); cached != missing.end();) {
+            auto n = cached->getN();
+            auto l = cached->getL();
+            auto j = cached->getJ();
+            auto value = store->find(MatrixElementStore::makeKey(cached->getMethod(),
+                                                                 cached->getSpecies(),
+                                                                 cached->getKappa(), n[0], l[0],
+                                                                 j[0], n[1], l[1], j[1]));
+            if (value) {
+                save(*cached, value.value());
+                CacheTableCounters::add(counters_radial->local().store_hits);
+                cached = missing.erase(cached);
+            } else {
+                ++cached;
+            }
         }
+    }
 
-        if (!cache_radial_missing.empty()) {
+    // --- Load from database ---
+    if (!missing.empty() && !dbname.empty()) {
+        CacheTableTimer timer(counters_radial->local().database_nanoseconds);
+        stmt->exec("begin transaction;");
+
+        if (!missing.empty()) {
             stmt->set("select value from cache_radial where `method` = ?1 and `species` = ?2 and "
                       "`k` = ?3 and `n1` = ?4 and `l1` = ?5 and `j1` = ?6 and `n2` = ?7 and `l2` = "
                       "?8 and `j2` = ?9;");
             stmt->prepare();
 
-            for (auto cached = cache_radial_missing.begin();
-                 cached != cache_radial_missing.end();) {
-                stmt->bind(1, cached->method);
-                stmt->bind(2, cached->species);
-                stmt->bind(3, cached->kappa);
-                stmt->bind(4, cached->n[0]);
-                stmt->bind(5, cached->l[0]);
-                stmt->bind(6, cached->j[0]);
-                stmt->bind(7, cached->n[1]);
-                stmt->bind(8, cached->l[1]);
-                stmt->bind(9, cached->j[1]);
-                if (stmt->step()) {
-                    cache_radial.insert({*cached, stmt->get<double>(0)});
-                    cached = cache_radial_missing.erase(cached);
-                } else {
-                    ++cached;
-                }
-                stmt->reset();
-            }
-        }
-
-        if (!cache_angular_missing.empty()) {
-            stmt->set("select value from cache_angular where `k` = ?1 and `j1` = ?2 and `m1` = ?3 "
-                      "and `j2` = ?4 and `m2` = ?5;");
-            stmt->prepare();
-
-            for (auto cached = cache_angular_missing.begin();
-                 cached != cache_angular_missing.end();) {
-                stmt->bind(1, cached->kappa);
-                stmt->bind(2, cached->j[0]);
-                stmt->bind(3, cached->m[0]);
-                stmt->bind(4, cached->j[1]);
-                stmt->bind(5, cached->m[1]);
+            for (auto cached = missing.begin(); cached != missing.end();) {
+                auto n = cached->getN();
+                auto l = cached->getL();
+                auto j = cached->getJ();
+                stmt->bind(1, cached->getMethod());
+                stmt->bind(2, cached->getSpecies());
+                stmt->bind(3, cached->getKappa());
+                stmt->bind(4, n[0]);
+                stmt->bind(5, l[0]);
+                stmt->bind(6, j[0]);
+                stmt->bind(7, n[1]);
+                stmt->bind(8, l[1]);
+                stmt->bind(9, j[1]);
                 if (stmt->step()) {
-                    cache_angular.insert({*cached, stmt->get<double>(0)});
-                    cached = cache_angular_missing.erase(cached);
+                    save(*cached, stmt->get<double>(0));
+                    CacheTableCounters::add(counters_radial->local().database_hits);
+                    cached = missing.erase(cached);
                 } else {
                     ++cached;
                 }
@@ -696,272 +1100,170 @@ int MatrixElementCache::update() {
             }
         }
 
-        if (!cache_reduced_commutes_s_missing.empty()) {
-            stmt->set("select value from cache_reduced_commutes_s where `s` = ?1 and `k` = ?2 and "
-                      "`l1` = ?3 and `j1` = ?4 and `l2` = ?5 and `j2` = ?6;");
-            stmt->prepare();
+        stmt->exec("commit transaction;");
+    }
 
-            for (auto cached = cache_reduced_commutes_s_missing.begin();
-                 cached != cache_reduced_commutes_s_missing.end();) {
-                stmt->bind(1, cached->s);
-                stmt->bind(2, cached->kappa);
-                stmt->bind(3, cached->l[0]);
-                stmt->bind(4, cached->j[0]);
-                stmt->bind(5, cached->l[1]);
-                stmt->bind(6, cached->j[1]);
-                if (stmt->step()) {
-                    cache_reduced_commutes_s.insert({*cached, stmt->get<double>(0)});
-                    cached = cache_reduced_commutes_s_missing.erase(cached);
-                } else {
-                    ++cached;
+    // --- Calculate missing elements and write them to the database ---
+
+    // The elements are calculated in parallel. Afterwards, they are added to the cache and queued
+    // for writing to the database by the background thread.
+
+    if (!missing.empty()) {
+        CacheTableCounters::add(counters_radial->local().calculations, missing.size());
+        std::vector<CacheKey_cache_radial> keys(missing.begin(), missing.end());
+
+        // Sort the elements so that consecutive elements share wavefunctions which can be reused
+        // from the cache of wavefunctions and elements that differ only in the exponent are
+        // adjacent
+        auto states = [](const CacheKey_cache_radial &key) {
+            auto n = key.getN();
+            auto l = key.getL();
+            auto j = key.getJ();
+            return std::make_tuple(key.getMethod(), key.getSpecies(), n[0], l[0], j[0], n[1],
+                                   l[1], j[1]);
+        };
+        std::sort(keys.begin(), keys.end(),
+                  [&](const CacheKey_cache_radial &a, const CacheKey_cache_radial &b) {
+                      return std::make_tuple(states(a), a.getKappa()) <
+                          std::make_tuple(states(b), b.getKappa());
+                  });
+
+        // Group the elements that differ only in the exponent so that they are calculated in a
+        // single sweep over the wavefunctions
+        std::vector<std::array<size_t, 2>> groups; // first and last index of each group
+        for (size_t idx = 0; idx < keys.size(); ++idx) {
+            if (!groups.empty()) {
+                if (states(keys[groups.back()[0]]) == states(keys[idx])) {
+                    groups.back()[1] = idx + 1;
+                    continue;
                 }
-                stmt->reset();
             }
+            groups.push_back({idx, idx + 1});
         }
 
-        if (!cache_reduced_commutes_l_missing.empty()) {
-            stmt->set("select value from cache_reduced_commutes_l where `s` = ?1 and `k` = ?2 and "
-                      "`l1` = ?3 and `j1` = ?4 and `l2` = ?5 and `j2` = ?6;");
-            stmt->prepare();
-
-            for (auto cached = cache_reduced_commutes_l_missing.begin();
-                 cached != cache_reduced_commutes_l_missing.end();) {
-                stmt->bind(1, cached->s);
-                stmt->bind(2, cached->kappa);
-                stmt->bind(3, cached->l[0]);
-                stmt->bind(4, cached->j[0]);
-                stmt->bind(5, cached->l[1]);
-                stmt->bind(6, cached->j[1]);
-                if (stmt->step()) {
-                    cache_reduced_commutes_l.insert({*cached, stmt->get<double>(0)});
-                    cached = cache_reduced_commutes_l_missing.erase(cached);
-                } else {
-                    ++cached;
+        precalculateWavefunctions(keys);
+
+        auto values_of_groups =
+            calculateInParallel(groups, [&](const std::array<size_t, 2> &group) {
+                CacheTableTimer timer(counters_radial->local().calculation_nanoseconds);
+                const auto &cached = keys[group[0]];
+                auto n = cached.getN();
+                auto l = cached.getL();
+                auto j = cached.getJ();
+                QuantumDefect qd1(cached.getSpecies(), n[0], l[0], j[0], defectdbname);
+                QuantumDefect qd2(cached.getSpecies(), n[1], l[1], j[1], defectdbname);
+                std::vector<int> powers;
+                for (size_t idx = group[0]; idx < group[1]; ++idx) {
+                    powers.push_back(keys[idx].getKappa());
                 }
-                stmt->reset();
-            }
-        }
-
-        if (!cache_reduced_multipole_missing.empty()) {
-            stmt->set("select value from cache_reduced_multipole where `k` = ?1 and `l1` = ?2 and "
-                      "`l2` = ?3;");
-            stmt->prepare();
+                return calcRadialElements(cached.getMethod(), qd1, powers, qd2);
+            });
 
-            for (auto cached = cache_reduced_multipole_missing.begin();
-                 cached != cache_reduced_multipole_missing.end();) {
-                stmt->bind(1, cached->kappa);
-                stmt->bind(2, cached->l[0]);
-                stmt->bind(3, cached->l[1]);
-                if (stmt->step()) {
-                    cache_reduced_multipole.insert({*cached, stmt->get<double>(0)});
-                    cached = cache_reduced_multipole_missing.erase(cached);
-                } else {
-                    ++cached;
-                }
-                stmt->reset();
-            }
+        std::vector<double> values;
+        values.reserve(keys.size());
+        for (const auto &values_of_group : values_of_groups) {
+            values.insert(values.end(), values_of_group.begin(), values_of_group.end());
         }
-    }
 
-    // --- Calculate missing elements and write them to the database --- // TODO parallelize
+        std::vector<DatabaseWriter::Row> rows;
+        for (size_t idx = 0; idx < keys.size(); ++idx) {
+            auto &cached = keys[idx];
+            double val = values[idx];
 
-    if (!dbname.empty()) {
-        stmt->exec("begin transaction;");
-    }
-
-    if (!cache_radial_missing.empty()) {
-        if (!dbname.empty()) {
-            stmt->set("insert or ignore into cache_radial (method, species, k, n1, l1, j1, n2, l2, "
-                      "j2, value) values (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10);");
-            stmt->prepare();
-        }
+            save(cached, val);
 
-        for (auto &cached : cache_radial_missing) {
-            double val = 0;
-            QuantumDefect qd1(cached.species, cached.n[0], cached.l[0], cached.j[0], defectdbname);
-            QuantumDefect qd2(cached.species, cached.n[1], cached.l[1], cached.j[1], defectdbname);
-            val = calcRadialElement(qd1, cached.kappa, qd2);
-
-            cache_radial.insert({cached, val});
-
-            if (!dbname.empty()) {
-                stmt->bind(1, cached.method);
-                stmt->bind(2, cached.species);
-                stmt->bind(3, cached.kappa);
-                stmt->bind(4, cached.n[0]);
-                stmt->bind(5, cached.l[0]);
-                stmt->bind(6, cached.j[0]);
-                stmt->bind(7, cached.n[1]);
-                stmt->bind(8, cached.l[1]);
-                stmt->bind(9, cached.j[1]);
-                stmt->bind(10, val);
-                stmt->step();
-                stmt->reset();
+            // Elements from the adaptive integration are not written to the database
+            if (!dbname.empty() && !isAdaptive(cached.getMethod())) {
+                auto n = cached.getN();
+                auto l = cached.getL();
+                auto j = cached.getJ();
+                rows.push_back({cached.getMethod(), cached.getSpecies(), cached.getKappa(), n[0],
+                                l[0], j[0], n[1], l[1], j[1], val});
             }
         }
 
-        cache_radial_missing.clear();
-    }
-
-    if (!cache_angular_missing.empty()) {
-        if (!dbname.empty()) {
-            stmt->set("insert or ignore into cache_angular (k, j1, m1, j2, m2, value) values (?1, "
-                      "?2, ?3, ?4, ?5, ?6);");
-            stmt->prepare();
+        if (!rows.empty()) {
+            writer->push(std::move(rows));
         }
+    }
 
-        for (auto &cached : cache_angular_missing) {
-            float q = cached.m[0] - cached.m[1];
+    return 1;
+}
 
-            double val = pow(-1, int(cached.j[0] - cached.m[0])) *
-                WignerSymbols::wigner3j(cached.j[0], cached.kappa, cached.j[1], -cached.m[0], q,
-                                        cached.m[1]);
-            cache_angular.insert({cached, val});
+void MatrixElementCache::setMemoryLimitRadial(size_t bytes) {
+    // Each element occupies between two and four slots of the hash maps, depending on the load
+    memory_limit_radial = bytes;
+    size_t bytes_per_element = 4 * (sizeof(CacheKey_cache_radial) + sizeof(double) + 1);
+    cache_radial->set_capacity(bytes == 0 ? 0 : std::max<size_t>(1, bytes / bytes_per_element));
+}
 
-            if (!dbname.empty()) {
-                stmt->bind(1, cached.kappa);
-                stmt->bind(2, cached.j[0]);
-                stmt->bind(3, cached.m[0]);
-                stmt->bind(4, cached.j[1]);
-                stmt->bind(5, cached.m[1]);
-                stmt->bind(6, val);
-                stmt->step();
-                stmt->reset();
-            }
-        }
+void MatrixElementCache::setMemoryLimitWavefunction(size_t bytes) {
+    memory_limit_wavefunction = bytes;
+    cache_wavefunction->set_capacity(bytes == 0 ? std::numeric_limits<size_t>::max() : bytes);
+}
 
-        cache_angular_missing.clear();
-    }
+size_t MatrixElementCache::size() { return cache_radial->size() + cache_radial_loaded.size(); }
 
-    if (!cache_reduced_commutes_s_missing.empty()) {
-        if (!dbname.empty()) {
-            stmt->set(
-                "insert or ignore into cache_reduced_commutes_s (s, k, l1, j1, l2, j2, value) "
-                "values (?1, ?2, ?3, ?4, ?5, ?6, ?7);");
-            stmt->prepare();
-        }
+MatrixElementCacheUsage MatrixElementCache::getMemoryUsage() const {
+    MatrixElementCacheUsage usage;
 
-        for (auto &cached : cache_reduced_commutes_s_missing) {
-
-            // Check triangle conditions (violated e.g. for WignerSymbols::wigner6j(0, 0.5, 0.5,
-            // 0.5, 0, 1))
-            double val = 0;
-            if (cached.l[0] >= std::abs(cached.j[0] - cached.s) &&
-                cached.l[0] <= cached.j[0] + cached.s &&
-                cached.l[0] >= std::abs(cached.l[1] - cached.kappa) &&
-                cached.l[0] <= cached.l[1] + cached.kappa &&
-                cached.j[1] >= std::abs(cached.j[0] - cached.kappa) &&
-                cached.j[1] <= cached.j[0] + cached.kappa &&
-                cached.j[1] >= std::abs(cached.l[1] - cached.s) &&
-                cached.j[1] <=
-                    cached.l[1] + cached.s) { // TODO implement this in the wignerSymbols library
-                val = pow(-1, int(cached.l[0] + cached.s + cached.j[1] + cached.kappa)) *
-                    sqrt((2 * cached.j[0] + 1) * (2 * cached.j[1] + 1)) *
-                    WignerSymbols::wigner6j(cached.l[0], cached.j[0], cached.s, cached.j[1],
-                                            cached.l[1], cached.kappa);
-            }
-            cache_reduced_commutes_s.insert({cached, val});
-
-            if (!dbname.empty()) {
-                stmt->bind(1, cached.s);
-                stmt->bind(2, cached.kappa);
-                stmt->bind(3, cached.l[0]);
-                stmt->bind(4, cached.j[0]);
-                stmt->bind(5, cached.l[1]);
-                stmt->bind(6, cached.j[1]);
-                stmt->bind(7, val);
-                stmt->step();
-                stmt->reset();
-            }
-        }
-
-        cache_reduced_commutes_s_missing.clear();
-    }
+    usage.radial_elements = cache_radial->size();
+    usage.radial_bytes = cache_radial->memory();
+    usage.radial_limit = memory_limit_radial;
 
-    if (!cache_reduced_commutes_l_missing.empty()) {
-        if (!dbname.empty()) {
-            stmt->set(
-                "insert or ignore into cache_reduced_commutes_l (s, k, l1, j1, l2, j2, value) "
-                "values (?1, ?2, ?3, ?4, ?5, ?6, ?7);");
-            stmt->prepare();
-        }
+    usage.loaded_elements = cache_radial_loaded.size();
+    usage.loaded_bytes = cache_radial_loaded.bucket_count() * sizeof(void *) +
+        cache_radial_loaded.size() *
+            (sizeof(CacheKey_cache_radial) + sizeof(double) + 2 * sizeof(void *));
 
-        for (auto &cached : cache_reduced_commutes_l_missing) {
-
-            // Check triangle conditions (violated e.g. for WignerSymbols::wigner6j(0, 0.5, 0.5,
-            // 0.5, 0, 1))
-            double val = 0;
-            if (cached.s >= std::abs(cached.j[0] - cached.l[0]) &&
-                cached.s <= cached.j[0] + cached.l[0] &&
-                cached.s >= std::abs(cached.s - cached.kappa) &&
-                cached.s <= cached.s + cached.kappa &&
-                cached.j[1] >= std::abs(cached.j[0] - cached.kappa) &&
-                cached.j[1] <= cached.j[0] + cached.kappa &&
-                cached.j[1] >= std::abs(cached.s - cached.l[0]) &&
-                cached.j[1] <=
-                    cached.s + cached.l[0]) { // TODO implement this in the wignerSymbols library
-                val = pow(-1, int(cached.l[0] + cached.s + cached.j[0] + cached.kappa)) *
-                    sqrt((2 * cached.j[0] + 1) * (2 * cached.j[1] + 1)) *
-                    WignerSymbols::wigner6j(cached.s, cached.j[0], cached.l[0], cached.j[1],
-                                            cached.s, cached.kappa);
-            }
-            cache_reduced_commutes_l.insert({cached, val});
-
-            if (!dbname.empty()) {
-                stmt->bind(1, cached.s);
-                stmt->bind(2, cached.kappa);
-                stmt->bind(3, cached.l[0]);
-                stmt->bind(4, cached.j[0]);
-                stmt->bind(5, cached.l[1]);
-                stmt->bind(6, cached.j[1]);
-                stmt->bind(7, val);
-                stmt->step();
-                stmt->reset();
-            }
-        }
+    usage.wavefunction_elements = cache_wavefunction->count();
+    usage.wavefunction_bytes = cache_wavefunction->get_size();
+    usage.wavefunction_limit = memory_limit_wavefunction;
 
-        cache_reduced_commutes_l_missing.clear();
-    }
+    usage.angular_bytes = angular->memory();
 
-    if (!cache_reduced_multipole_missing.empty()) {
-        if (!dbname.empty()) {
-            stmt->set(
-                "insert or ignore into cache_reduced_multipole (k, l1, l2, value) values (?1, "
-                "?2, ?3, ?4);");
-            stmt->prepare();
-        }
+    usage.total_bytes =
+        usage.radial_bytes + usage.loaded_bytes + usage.wavefunction_bytes + usage.angular_bytes;
+    return usage;
+}
 
-        for (auto &cached : cache_reduced_multipole_missing) {
+MatrixElementCacheStatistics MatrixElementCache::getStatistics() const {
+    MatrixElementCacheStatistics statistics;
+    statistics.radial = counters_radial->snapshot();
+    statistics.wavefunction = counters_wavefunction->snapshot();
+
+    auto angular_statistics = angular->getStatistics();
+    statistics.angular = angular_statistics.angular;
+    statistics.reduced_commutes_s = angular_statistics.reduced_commutes_s;
+    statistics.reduced_commutes_l = angular_statistics.reduced_commutes_l;
+    statistics.reduced_multipole = angular_statistics.reduced_multipole;
+    return statistics;
+}
 
-            double val = pow(-1, cached.l[0]) *
-                sqrt((2 * cached.l[0] + 1) * (2 * cached.l[1] + 1)) *
-                WignerSymbols::wigner3j(
-                             cached.l[0], cached.kappa, cached.l[1], 0, 0,
-                             0); // TODO call WignerSymbols::wigner3j(cached.kappa,
-                                 // cached.l[1], 0, 0, 0) and loop over the resulting vector
-            cache_reduced_multipole.insert({cached, val});
+void MatrixElementCache::resetStatistics() {
+    counters_radial->reset();
+    counters_wavefunction->reset();
+    angular->resetStatistics();
+}
 
-            if (!dbname.empty()) {
-                stmt->bind(1, cached.kappa);
-                stmt->bind(2, cached.l[0]);
-                stmt->bind(3, cached.l[1]);
-                stmt->bind(4, val);
-                stmt->step();
-                stmt->reset();
-            }
-        }
+void MatrixElementCache::openDatabase() {
+    writer.reset();
 
-        cache_reduced_multipole_missing.clear();
-    }
+    db = std::make_unique<sqlite::handle>(dbname);
+    stmt = std::make_unique<sqlite::statement>(*db);
+    pid_which_created_db = utils::get_pid();
 
-    if (!dbname.empty()) {
-        stmt->exec("commit transaction;");
-    }
+    // Use write-ahead logging so that several processes can read from and write to the database
+    // concurrently
+    stmt->exec("PRAGMA journal_mode = WAL");
+    stmt->exec("PRAGMA synchronous = NORMAL");
 
-    return 1;
-}
+    // Create cache table (the angular parts of the matrix elements need not to be cached since they
+    // are cheap to calculate)
+    stmt->exec("create table if not exists cache_radial ("
+               "method int, species text, k integer, n1 integer, l1 integer, j1 double,"
+               "n2 integer, l2 integer, j2 double, value double, primary key (method, species, k, "
+               "n1, l1, j1, n2, l2, j2)) without rowid;");
 
-size_t MatrixElementCache::size() {
-    return cache_radial.size() + cache_angular.size() + cache_reduced_commutes_s.size() +
-        cache_reduced_commutes_l.size() + cache_reduced_multipole.size();
+    writer = std::make_unique<DatabaseWriter>(dbname);
 }
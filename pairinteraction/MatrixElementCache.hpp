@@ -20,7 +20,13 @@
 #ifndef MATRIXELEMENTCACHE_H
 #define MATRIXELEMENTCACHE_H
 
+#include "AngularCoefficients.hpp"
 #include "Basisnames.hpp"
+#include "Cache.hpp"
+#include "CacheStatistics.hpp"
+#include "DatabaseWriter.hpp"
+#include "MatrixElementStore.hpp"
+#include "SQLite.hpp"
 #include "State.hpp"
 #include "Wavefunction.hpp"
 #include "dtypes.hpp"
@@ -34,15 +40,19 @@
 #    include <boost/serialization/library_version_type.hpp>
 #endif
 // clang-format on
+#include <boost/serialization/split_member.hpp>
 #include <boost/serialization/unordered_map.hpp>
 #include <boost/serialization/unordered_set.hpp>
-#include <wignerSymbols/wignerSymbols-cpp.h>
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <vector>
 
 class StateOne;
 class StateTwo;
@@ -54,6 +64,84 @@ bool selectionRulesMomentumNew(StateOne const &state1, StateOne const &state2);
 bool selectionRulesMultipoleNew(StateOne const &state1, StateOne const &state2, int kappa, int q);
 bool selectionRulesMultipoleNew(StateOne const &state1, StateOne const &state2, int kappa);
 
+/** \brief Number of elements and allocated bytes of the tables of a MatrixElementCache
+ *
+ * The limits are zero if the size of a table is not bounded.
+ */
+struct MatrixElementCacheUsage {
+    // Calculated radial matrix elements
+    size_t radial_elements{0};
+    size_t radial_bytes{0};
+    size_t radial_limit{0};
+
+    // Radial matrix elements from loadElectricDipoleDB
+    size_t loaded_elements{0};
+    size_t loaded_bytes{0};
+
+    // Integrated radial wavefunctions
+    size_t wavefunction_elements{0};
+    size_t wavefunction_bytes{0};
+    size_t wavefunction_limit{0};
+
+    // Angular coefficients
+    size_t angular_bytes{0};
+
+    // Sum of all tables
+    size_t total_bytes{0};
+};
+
+/** \brief Lookups of the tables of a MatrixElementCache and the time spent on filling them
+ *
+ * The calculation time of the radial matrix elements includes the integration of the
+ * wavefunctions, which is reported separately as well.
+ */
+struct MatrixElementCacheStatistics {
+    CacheTableStatistics radial;
+    CacheTableStatistics wavefunction;
+    CacheTableStatistics angular;
+    CacheTableStatistics reduced_commutes_s;
+    CacheTableStatistics reduced_commutes_l;
+    CacheTableStatistics reduced_multipole;
+};
+
+/** \brief Cache for the matrix elements of single atoms
+ *
+ * The getters and update() can be called from several threads concurrently, so that a single
+ * cache can be shared by systems that are built in parallel. The configuration (setDefectDB,
+ * setMethod, setStore, loadElectricDipoleDB) must not be changed and exportStore, which reopens
+ * the store, must not be called while other threads use the cache.
+ *
+ * Missing radial matrix elements are looked up in a read-only MatrixElementStore, then in the
+ * SQLite database of the cache directory, and are calculated if they are found in neither. The
+ * store is opened automatically if the cache directory contains one that has been written by
+ * exportStore. Calculated elements are written to the database by a background thread, several
+ * processes can share the same cache directory.
+ *
+ * The memory used by the radial matrix elements and the integrated wavefunctions can be bounded
+ * by setMemoryLimitRadial and setMemoryLimitWavefunction. If a limit is exceeded, elements that
+ * have not been used recently are evicted. Evicted radial matrix elements are restored from the
+ * store or the database, or are calculated again if they are needed later on. The limit of the
+ * radial matrix elements is approximate since each shard of the table keeps at least one element
+ * and allocates at least a small hash map.
+ *
+ * By default, the wavefunctions of Numerov's method are integrated with the fixed step
+ * Numerov::dx. If a tolerance is set by setRadialTolerance, the radial matrix elements are
+ * calculated on coarser grids instead and the step is halved until the Richardson-extrapolated
+ * results agree within the tolerance. These elements are not written to the database, so that it
+ * only contains the results of the fixed step. The tolerance refers to the largest elements
+ * between states of the same principal quantum number. For states that penetrate the core, the
+ * integration close to the inner bound converges more slowly, so that the results can deviate
+ * from the fixed step by about 1e-6 of these elements even for smaller tolerances.
+ *
+ * The method SEMICLASSICAL approximates radial dipole matrix elements between states that do not
+ * penetrate the core by a closed-form expression, see semiclassical::RadialDipoleElement, which
+ * deviates from Numerov's method by less than 0.5%. All other elements are calculated by
+ * Numerov's method, see semiclassical::IsValid.
+ *
+ * getStatistics counts the lookups of each table, how many missing elements were loaded from the
+ * store or the database or were calculated, and how long this took. The counters can be reset by
+ * resetStatistics, e.g. to measure a single calculation.
+ */
 class MatrixElementCache {
 public:
     MatrixElementCache();
@@ -78,19 +166,53 @@ public:
     void precalculateDiamagnetism(const std::vector<StateOne> &basis_one, int k, int q);
     void precalculateMultipole(const std::vector<StateOne> &basis_one, int k);
     void precalculateRadial(const std::vector<StateOne> &basis_one, int k);
+    int update();
+
+    /** \brief Calculate the matrix elements of all states within a range of quantum numbers
+     *
+     * The radial matrix elements are calculated for all pairs of states with n_range[0] <= n <=
+     * n_range[1] and l <= l_max that are coupled by a multipole operator of one of the given
+     * orders kappa, i.e. |l1-l2| <= kappa and l1+l2+kappa is even. Elements that are neither in
+     * the memory, the store, nor the database are calculated in parallel. The method returns after
+     * they have been written to the database. The angular coefficients of the states are
+     * calculated as well, they are kept in the memory only.
+     *
+     * \param method_warm Method for calculating the radial matrix elements, independent of the
+     * method set by setMethod
+     * \returns Number of radial matrix elements that were not in the memory before
+     */
+    size_t warm(std::string const &species, std::array<int, 2> const &n_range, int l_max,
+                std::vector<int> const &kappas, method_t method_warm);
 
     void setDefectDB(std::string const &path);
     const std::string &getDefectDB() const;
     void setMethod(method_t const &m);
+    void setRadialTolerance(double tolerance); // zero means the fixed step (default)
     void loadElectricDipoleDB(std::string const &path, std::string const &species);
+    void setStore(std::string const &path);
+    void exportStore(std::string const &path);
+
+    void setMemoryLimitRadial(size_t bytes);       // zero means unbounded (default)
+    void setMemoryLimitWavefunction(size_t bytes); // default 256 MiB
 
     size_t size();
+    MatrixElementCacheUsage getMemoryUsage() const;
+    MatrixElementCacheStatistics getStatistics() const;
+    void resetStatistics();
 
 private:
-    int update();
     void precalculate(std::shared_ptr<const BasisnamesOne> basis_one, int kappa, int q, int kappar,
                       bool calcMultipole, bool calcMomentum, bool calcRadial);
-    double calcRadialElement(const QuantumDefect &qd1, int power, const QuantumDefect &qd2);
+    std::vector<double> calcRadialElements(method_t method, const QuantumDefect &qd1,
+                                           const std::vector<int> &powers,
+                                           const QuantumDefect &qd2);
+    std::vector<double> calcRadialElementsAdaptive(const QuantumDefect &qd1,
+                                                   const std::vector<int> &powers,
+                                                   const QuantumDefect &qd2);
+    bool isAdaptive(method_t method_radial) const; // whether calculated with the tolerance
+    template <typename T>
+    std::shared_ptr<const eigen_dense_double_t>
+    getWavefunction(method_t method, const QuantumDefect &qd, int stride = 1);
     void precalculate(const std::vector<StateOne> &basis_one, int kappa_angular, int q,
                       int kappa_radial, bool calcElectricMultipole, bool calcMagneticMomentum,
                       bool calcRadial);
@@ -99,116 +221,135 @@ private:
     /// Keys ///////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////
 
+    /** \brief Key of a radial matrix element
+     *
+     * The quantum numbers are packed into two 64-bit integers, the species
+     * is represented by its index in a process-wide table of species names.
+     * Thus, comparing and hashing keys does not touch any strings.
+     */
     struct CacheKey_cache_radial {
-        CacheKey_cache_radial(method_t method, std::string species, int kappa, int n1, int n2,
-                              int l1, int l2, float j1, float j2);
+        CacheKey_cache_radial(method_t method, std::string const &species, int kappa, int n1,
+                              int n2, int l1, int l2, float j1, float j2);
         CacheKey_cache_radial();
         bool operator==(const CacheKey_cache_radial &rhs) const;
-        std::string species;
-        method_t method;
-        int kappa;
-        std::array<int, 2> n, l;
-        std::array<float, 2> j;
+        method_t getMethod() const;
+        const std::string &getSpecies() const;
+        int getKappa() const;
+        std::array<int, 2> getN() const;
+        std::array<int, 2> getL() const;
+        std::array<float, 2> getJ() const;
+        uint64_t high{0}; // method, species, kappa, n1, n2
+        uint64_t low{0};  // l1, l2, 2*j1, 2*j2
 
     private:
         friend class boost::serialization::access;
         template <class Archive>
-        void serialize(Archive &ar, const unsigned int /*version*/) {
+        void save(Archive &ar, const unsigned int /*version*/) const {
+            method_t method = getMethod();
+            std::string species = getSpecies();
+            int kappa = getKappa();
+            std::array<int, 2> n = getN(), l = getL();
+            std::array<float, 2> j = getJ();
             ar &method &species &kappa &n &l &j;
         }
-    };
-
-    struct CacheKey_cache_angular {
-        CacheKey_cache_angular(int kappa, float j1, float j2, float m1, float m2);
-        CacheKey_cache_angular();
-        bool operator==(const CacheKey_cache_angular &rhs) const;
-        int kappa;
-        std::array<float, 2> j, m;
-        int sgn;
-
-    private:
-        friend class boost::serialization::access;
-        template <class Archive>
-        void serialize(Archive &ar, const unsigned int /*version*/) {
-            ar &kappa &j &m &sgn;
-        }
-    };
-
-    struct CacheKey_cache_reduced_commutes {
-        CacheKey_cache_reduced_commutes(float s, int kappa, int l1, int l2, float j1, float j2);
-        CacheKey_cache_reduced_commutes();
-        bool operator==(const CacheKey_cache_reduced_commutes &rhs) const;
-        float s;
-        int kappa;
-        std::array<int, 2> l;
-        std::array<float, 2> j;
-        int sgn;
-
-    private:
-        friend class boost::serialization::access;
         template <class Archive>
-        void serialize(Archive &ar, const unsigned int /*version*/) {
-            ar &s &kappa &l &j &sgn;
+        void load(Archive &ar, const unsigned int /*version*/) {
+            method_t method;
+            std::string species;
+            int kappa;
+            std::array<int, 2> n, l;
+            std::array<float, 2> j;
+            ar &method &species &kappa &n &l &j;
+            *this = CacheKey_cache_radial(method, species, kappa, n[0], n[1], l[0], l[1], j[0],
+                                          j[1]);
         }
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
     };
 
-    struct CacheKey_cache_reduced_multipole {
-        CacheKey_cache_reduced_multipole(int kappa, int l1, int l2);
-        CacheKey_cache_reduced_multipole();
-        bool operator==(const CacheKey_cache_reduced_multipole &rhs) const;
-        int kappa;
-        std::array<int, 2> l;
-        int sgn;
-
-    private:
-        friend class boost::serialization::access;
-        template <class Archive>
-        void serialize(Archive &ar, const unsigned int /*version*/) {
-            ar &kappa &l &sgn;
-        }
+    struct CacheKey_cache_wavefunction {
+        bool operator==(const CacheKey_cache_wavefunction &rhs) const;
+        method_t method;
+        std::string species;
+        int n, l;
+        double j;
+        int stride{1};
     };
 
     struct CacheKeyHasher_cache_radial {
         std::size_t operator()(const CacheKey_cache_radial &c) const;
     };
-    struct CacheKeyHasher_cache_angular {
-        std::size_t operator()(const CacheKey_cache_angular &c) const;
-    };
-    struct CacheKeyHasher_cache_reduced_commutes {
-        std::size_t operator()(const CacheKey_cache_reduced_commutes &c) const;
-    };
-    struct CacheKeyHasher_cache_reduced_multipole {
-        std::size_t operator()(const CacheKey_cache_reduced_multipole &c) const;
+    struct CacheKeyHasher_cache_wavefunction {
+        std::size_t operator()(const CacheKey_cache_wavefunction &c) const;
     };
 
-    std::unordered_map<CacheKey_cache_radial, double, CacheKeyHasher_cache_radial> cache_radial;
-    std::unordered_map<CacheKey_cache_angular, double, CacheKeyHasher_cache_angular> cache_angular;
-    std::unordered_map<CacheKey_cache_reduced_commutes, double,
-                       CacheKeyHasher_cache_reduced_commutes>
-        cache_reduced_commutes_s;
-    std::unordered_map<CacheKey_cache_reduced_commutes, double,
-                       CacheKeyHasher_cache_reduced_commutes>
-        cache_reduced_commutes_l;
-    std::unordered_map<CacheKey_cache_reduced_multipole, double,
-                       CacheKeyHasher_cache_reduced_multipole>
-        cache_reduced_multipole;
+    double getRadialElement(const CacheKey_cache_radial &key);
 
+    /** \brief Load or calculate the missing radial matrix elements
+     *
+     * The elements that have been reported as missing and the keys of \p requested are loaded
+     * from the store or the database, or are calculated. The values of the keys of \p requested
+     * are written to the map, so that they do not need to be restored from the cache, from which
+     * they might have been evicted already. The caller must hold mutex_update.
+     *
+     * \returns 0 if no element was missing, 1 otherwise
+     */
+    int updateRadial(
+        std::unordered_map<CacheKey_cache_radial, double, CacheKeyHasher_cache_radial> &requested);
+    void precalculateWavefunctions(const std::vector<CacheKey_cache_radial> &keys);
+    void openDatabase();
+
+    // Process-wide table of species names, the index of a name is used in the keys
+    static uint16_t getSpeciesIndex(std::string const &species);
+    static const std::string &getSpeciesName(uint16_t index);
+
+    // Radial matrix elements (the cache is sharded so that threads can look up elements
+    // concurrently)
+    std::unique_ptr<ShardedCache<CacheKey_cache_radial, double, CacheKeyHasher_cache_radial>>
+        cache_radial;
+
+    // Radial matrix elements from loadElectricDipoleDB (they are never evicted because they cannot
+    // be calculated again, the table is only changed by the configuration)
+    std::unordered_map<CacheKey_cache_radial, double, CacheKeyHasher_cache_radial>
+        cache_radial_loaded;
+
+    // Radial matrix elements that are calculated by the next call of update()
     std::unordered_set<CacheKey_cache_radial, CacheKeyHasher_cache_radial> cache_radial_missing;
-    std::unordered_set<CacheKey_cache_angular, CacheKeyHasher_cache_angular> cache_angular_missing;
-    std::unordered_set<CacheKey_cache_reduced_commutes, CacheKeyHasher_cache_reduced_commutes>
-        cache_reduced_commutes_s_missing;
-    std::unordered_set<CacheKey_cache_reduced_commutes, CacheKeyHasher_cache_reduced_commutes>
-        cache_reduced_commutes_l_missing;
-    std::unordered_set<CacheKey_cache_reduced_multipole, CacheKeyHasher_cache_reduced_multipole>
-        cache_reduced_multipole_missing;
+    std::unique_ptr<std::mutex> mutex_cache_radial_missing;
+
+    // Only one thread at a time calculates missing elements and accesses the database
+    std::unique_ptr<std::mutex> mutex_update;
+
+    // Angular parts of the matrix elements (not serialized, they are cheap to recalculate)
+    std::unique_ptr<AngularCoefficients> angular;
+
+    // Integrated radial wavefunctions, shared by all radial matrix elements of a state (not
+    // serialized, the size is limited to max_size_cache_wavefunction bytes by default)
+    static constexpr size_t max_size_cache_wavefunction = 256 * 1024 * 1024;
+    std::unique_ptr<LRUCache<CacheKey_cache_wavefunction,
+                             std::shared_ptr<const eigen_dense_double_t>,
+                             CacheKeyHasher_cache_wavefunction>>
+        cache_wavefunction;
+
+    // Counters of the lookups (not serialized)
+    std::unique_ptr<CacheTableCounters> counters_radial;
+    std::unique_ptr<CacheTableCounters> counters_wavefunction;
+
+    size_t memory_limit_radial{0};
+    size_t memory_limit_wavefunction{max_size_cache_wavefunction};
 
     method_t method{NUMEROV};
+    double radial_tolerance{0};
+    static constexpr int max_stride_radial = 32; // coarsest step of the adaptive integration
     std::string defectdbname;
     std::string dbname;
     std::unique_ptr<sqlite::handle> db;
     std::unique_ptr<sqlite::statement> stmt;
+    std::unique_ptr<DatabaseWriter> writer;
     long pid_which_created_db;
 
+    // Read-only store of radial matrix elements that is searched before the database
+    std::unique_ptr<MatrixElementStore> store;
+
     ////////////////////////////////////////////////////////////////////
     /// Method for serialization ///////////////////////////////////////
     ////////////////////////////////////////////////////////////////////
@@ -217,23 +358,36 @@ private:
     template <class Archive>
     void serialize(Archive &ar, const unsigned int /*version*/) {
         ar &method;
+        ar &radial_tolerance;
         ar &dbname;
-        ar &cache_radial &cache_angular &cache_reduced_commutes_s &cache_reduced_commutes_l
-            &cache_reduced_multipole;
-        ar &cache_radial_missing &cache_angular_missing &cache_reduced_commutes_s_missing
-            &cache_reduced_commutes_l_missing &cache_reduced_multipole_missing;
+        std::unordered_map<CacheKey_cache_radial, double, CacheKeyHasher_cache_radial> radial;
+        if (Archive::is_saving::value) {
+            radial = cache_radial->copy();
+        }
+        ar &memory_limit_radial &memory_limit_wavefunction;
+        ar &radial;
+        if (Archive::is_loading::value) {
+            cache_radial->clear();
+            setMemoryLimitRadial(memory_limit_radial);
+            setMemoryLimitWavefunction(memory_limit_wavefunction);
+            for (auto const &entry : radial) {
+                cache_radial->save(entry.first, entry.second);
+            }
+        }
+        ar &cache_radial_loaded;
+        ar &cache_radial_missing;
+
+        std::string storename;
+        if (Archive::is_saving::value && store) {
+            storename = store->getPath();
+        }
+        ar &storename;
+        if (Archive::is_loading::value && !storename.empty()) {
+            store = std::make_unique<MatrixElementStore>(storename);
+        }
 
         if (Archive::is_loading::value && !dbname.empty()) {
-            // Open database
-            db = std::make_unique<sqlite::handle>(dbname);
-            stmt = std::make_unique<sqlite::statement>(*db);
-            pid_which_created_db = utils::get_pid();
-
-            // Speed up database access
-            stmt->exec(
-                "PRAGMA synchronous = OFF"); // do not wait on write, hand off to OS and carry on
-            stmt->exec("PRAGMA journal_mode = MEMORY"); // keep rollback journal in memory during
-                                                        // transaction
+            openDatabase();
         }
     }
 };
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MatrixElementStore.hpp"
+#include "filesystem.hpp"
+
+#include <boost/interprocess/exceptions.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+
+////////////////////////////////////////////////////////////////////
+/// Keys ///////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+bool MatrixElementStore::Key::operator<(Key const &rhs) const {
+    return std::tie(method, species, kappa, n1, l1, twoj1, n2, l2, twoj2) <
+        std::tie(rhs.method, rhs.species, rhs.kappa, rhs.n1, rhs.l1, rhs.twoj1, rhs.n2, rhs.l2,
+                 rhs.twoj2);
+}
+
+bool MatrixElementStore::Key::operator==(Key const &rhs) const {
+    return std::tie(method, species, kappa, n1, l1, twoj1, n2, l2, twoj2) ==
+        std::tie(rhs.method, rhs.species, rhs.kappa, rhs.n1, rhs.l1, rhs.twoj1, rhs.n2, rhs.l2,
+                 rhs.twoj2);
+}
+
+MatrixElementStore::Key MatrixElementStore::makeKey(method_t method, std::string const &species,
+                                                    int kappa, int n1, int l1, float j1, int n2,
+                                                    int l2, float j2) {
+    Key key{};
+    if (species.size() >= key.species.size()) {
+        throw std::runtime_error("The name of the species " + species +
+                                 " is too long for the matrix element store.");
+    }
+    std::copy(species.begin(), species.end(), key.species.begin());
+    key.method = method;
+    key.kappa = kappa;
+    key.n1 = n1;
+    key.l1 = l1;
+    key.twoj1 = std::lround(2 * j1);
+    key.n2 = n2;
+    key.l2 = l2;
+    key.twoj2 = std::lround(2 * j2);
+    return key;
+}
+
+////////////////////////////////////////////////////////////////////
+/// Store //////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+MatrixElementStore::MatrixElementStore(std::string const &path) : path(path) {
+    try {
+        file = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only);
+        region = boost::interprocess::mapped_region(file, boost::interprocess::read_only);
+    } catch (boost::interprocess::interprocess_exception &e) {
+        throw std::runtime_error("The matrix element store " + path +
+                                 " could not be opened: " + e.what());
+    }
+
+    // Check the header
+    const auto *begin = static_cast<const char *>(region.get_address());
+    if (region.get_size() < sizeof(Header)) {
+        throw std::runtime_error("The file " + path + " is not a matrix element store.");
+    }
+    const auto *header = reinterpret_cast<const Header *>(begin);
+    if (header->magic != magic) {
+        throw std::runtime_error("The file " + path + " is not a matrix element store.");
+    }
+    if (header->version != version || header->key_size != sizeof(Key)) {
+        throw std::runtime_error("The matrix element store " + path +
+                                 " has been written by an incompatible version.");
+    }
+    if (region.get_size() != sizeof(Header) + header->size * (sizeof(Key) + sizeof(double))) {
+        throw std::runtime_error("The matrix element store " + path + " is truncated.");
+    }
+
+    num_elements = header->size;
+    keys = reinterpret_cast<const Key *>(begin + sizeof(Header));
+    values = reinterpret_cast<const double *>(begin + sizeof(Header) + num_elements * sizeof(Key));
+}
+
+std::optional<double> MatrixElementStore::find(Key const &key) const {
+    const Key *it = std::lower_bound(keys, keys + num_elements, key);
+    if (it != keys + num_elements && *it == key) {
+        return values[it - keys];
+    }
+    return std::nullopt;
+}
+
+std::vector<std::pair<MatrixElementStore::Key, double>> MatrixElementStore::elements() const {
+    std::vector<std::pair<Key, double>> elements(num_elements);
+    for (size_t idx = 0; idx < num_elements; ++idx) {
+        elements[idx] = {keys[idx], values[idx]};
+    }
+    return elements;
+}
+
+size_t MatrixElementStore::size() const { return num_elements; }
+
+const std::string &MatrixElementStore::getPath() const { return path; }
+
+void MatrixElementStore::write(std::string const &path,
+                               std::vector<std::pair<Key, double>> elements) {
+    // Sort the elements by their keys and remove duplicates
+    std::stable_sort(
+        elements.begin(), elements.end(),
+        [](std::pair<Key, double> const &a, std::pair<Key, double> const &b) {
+            return a.first < b.first;
+        });
+    elements.erase(std::unique(elements.begin(), elements.end(),
+                               [](std::pair<Key, double> const &a,
+                                  std::pair<Key, double> const &b) { return a.first == b.first; }),
+                   elements.end());
+
+    // Write to a temporary file that replaces the store at the end, so that on POSIX systems,
+    // processes which have mapped the old store are not affected. On Windows, a store cannot be
+    // replaced while it is mapped.
+    std::string path_tmp = path + ".tmp";
+    {
+        std::ofstream ofs(path_tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs) {
+            throw std::runtime_error("The matrix element store " + path +
+                                     " could not be written.");
+        }
+
+        Header header{magic, version, sizeof(Key), elements.size()};
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        for (auto const &element : elements) {
+            ofs.write(reinterpret_cast<const char *>(&element.first), sizeof(Key));
+        }
+        for (auto const &element : elements) {
+            ofs.write(reinterpret_cast<const char *>(&element.second), sizeof(double));
+        }
+
+        if (!ofs) {
+            throw std::runtime_error("The matrix element store " + path +
+                                     " could not be written.");
+        }
+    }
+    fs::rename(path_tmp, path);
+}
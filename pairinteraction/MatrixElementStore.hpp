@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATRIXELEMENTSTORE_H
+#define MATRIXELEMENTSTORE_H
+
+#include "dtypes.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** \brief Read-only store of radial matrix elements in a memory-mapped file
+ *
+ * The file consists of a small header, the keys of the matrix
+ * elements sorted in ascending order, and the values in the order of
+ * the keys. The file is mapped into memory and the elements are found
+ * by binary search, so that opening a store neither parses nor copies
+ * the data. Processes that open the same file share its pages through
+ * the page cache of the operating system.
+ *
+ * The file uses the byte order of the machine that has written it.
+ */
+class MatrixElementStore {
+public:
+    /** \brief Key of a radial matrix element
+     *
+     * The quantum numbers j are stored doubled so that all of them are
+     * integers. The species is stored as a zero-padded string.
+     */
+    struct Key {
+        int32_t method;
+        std::array<char, 16> species;
+        int32_t kappa;
+        int32_t n1, l1, twoj1;
+        int32_t n2, l2, twoj2;
+
+        bool operator<(Key const &rhs) const;
+        bool operator==(Key const &rhs) const;
+    };
+
+    /** \brief Construct a key
+     *
+     * \throws std::runtime_error if the name of the species is too long
+     */
+    static Key makeKey(method_t method, std::string const &species, int kappa, int n1, int l1,
+                       float j1, int n2, int l2, float j2);
+
+    /** \brief Open an existing store
+     *
+     * \param path Path to the file of the store
+     * \throws std::runtime_error if the file is not a valid store
+     */
+    explicit MatrixElementStore(std::string const &path);
+
+    /** \brief Look up a matrix element
+     *
+     * \param key Key
+     * \returns Optional value
+     */
+    std::optional<double> find(Key const &key) const;
+
+    /** \brief Copy all matrix elements of the store */
+    std::vector<std::pair<Key, double>> elements() const;
+
+    /** \brief Number of matrix elements in the store */
+    size_t size() const;
+
+    /** \brief Write a new store
+     *
+     * If a key occurs several times, the first occurrence is written.
+     *
+     * \param path Path to the file of the store
+     * \param elements Matrix elements
+     */
+    static void write(std::string const &path, std::vector<std::pair<Key, double>> elements);
+
+    const std::string &getPath() const;
+
+private:
+    struct Header {
+        std::array<char, 8> magic;
+        uint32_t version;
+        uint32_t key_size;
+        uint64_t size;
+    };
+
+    static constexpr std::array<char, 8> magic{{'P', 'I', 'S', 'T', 'O', 'R', 'E', '\0'}};
+    static constexpr uint32_t version = 1;
+
+    std::string path;
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region region;
+    const Key *keys{nullptr};
+    const double *values{nullptr};
+    size_t num_elements{0};
+};
+
+#endif
@@ -25,10 +25,14 @@
 #include <cmath>
 #include <exception>
 #include <fstream>
-#include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 struct no_defect : public std::exception {
 private:
@@ -54,144 +58,169 @@ public:
     const char *what() const noexcept override { return msg.c_str(); }
 };
 
+////////////////////////////////////////////////////////////////////
+/// Tables /////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+struct QuantumDefect::Tables {
+    struct Species {
+        // Rows in the order of the database, the first matching row is used
+        std::vector<embedded_database::ModelPotential> model_potential;
+        std::vector<embedded_database::RydbergRitz> rydberg_ritz;
+    };
+    std::unordered_map<std::string, Species> species;
+};
+
+QuantumDefect::Tables const &QuantumDefect::getTables(std::string const &database) {
+    if (database.empty()) {
+        static const Tables embedded = []() {
+            Tables tables;
+            for (auto const &row : embedded_database::model_potential) {
+                tables.species[row.element].model_potential.push_back(row);
+            }
+            for (auto const &row : embedded_database::rydberg_ritz) {
+                tables.species[row.element].rydberg_ritz.push_back(row);
+            }
+            return tables;
+        }();
+        return embedded;
+    }
+
+    // Usually, a single user-defined database is used, thus the last one is remembered by each
+    // thread and looked up without locking
+    thread_local std::string last_database;
+    thread_local const Tables *last_tables = nullptr;
+    if (last_tables != nullptr && database == last_database) {
+        return *last_tables;
+    }
+
+    // Each user-defined database is loaded only once, the tables are never freed so that the
+    // pointers remembered by the threads stay valid
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::unique_ptr<const Tables>> loaded;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto &tables = loaded[database];
+    if (!tables) {
+        std::ifstream ifs(database);
+        if (!ifs) {
+            throw std::runtime_error("The database " + database + " could not be opened.");
+        }
+        std::stringstream buffer;
+        buffer << ifs.rdbuf();
+
+        sqlite::handle db(":memory:");
+        sqlite::statement stmt(db);
+        stmt.exec(buffer.str());
+
+        auto new_tables = std::make_unique<Tables>();
+        stmt.set("select element,L,ac,Z,a1,a2,a3,a4,rc from model_potential order by rowid;");
+        stmt.prepare();
+        while (stmt.step()) {
+            auto it = new_tables->species.try_emplace(stmt.get<std::string>(0)).first;
+            it->second.model_potential.push_back(
+                {it->first.c_str(), stmt.get<int>(1), stmt.get<double>(2), stmt.get<int>(3),
+                 stmt.get<double>(4), stmt.get<double>(5), stmt.get<double>(6),
+                 stmt.get<double>(7), stmt.get<double>(8)});
+        }
+        stmt.reset();
+        stmt.set("select element,L,J,d0,d2,d4,d6,d8,Ry from rydberg_ritz order by rowid;");
+        stmt.prepare();
+        while (stmt.step()) {
+            auto it = new_tables->species.try_emplace(stmt.get<std::string>(0)).first;
+            it->second.rydberg_ritz.push_back(
+                {it->first.c_str(), stmt.get<int>(1), stmt.get<double>(2), stmt.get<double>(3),
+                 stmt.get<double>(4), stmt.get<double>(5), stmt.get<double>(6),
+                 stmt.get<double>(7), stmt.get<double>(8)});
+        }
+        tables = std::move(new_tables);
+    }
+
+    last_database = database;
+    last_tables = tables.get();
+    return *tables;
+}
+
+////////////////////////////////////////////////////////////////////
+/// Quantum defect /////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
 QuantumDefect::QuantumDefect(std::string _species, int _n, int _l, double _j, std::nullptr_t)
     : e(), species(std::move(_species)), n(_n), l(_l), j(_j), ac(e.ac), Z(e.Z), a1(e.a1), a2(e.a2),
       a3(e.a3), a4(e.a4), rc(e.rc), nstar(e.nstar), energy(e.energy) {}
 
 QuantumDefect::QuantumDefect(std::string const &species, int n, int l, double j)
     : QuantumDefect(species, n, l, j, nullptr) {
-    static thread_local EmbeddedDatabase embedded_database{};
-    setup(embedded_database, "");
+    setup(getTables(""));
 }
 
 QuantumDefect::QuantumDefect(std::string const &species, int n, int l, double j,
                              std::string const &database)
     : QuantumDefect(species, n, l, j, nullptr) {
-    if (database.empty()) {
-        static thread_local EmbeddedDatabase embedded_database{};
-        setup(embedded_database, database);
-    } else {
-        static thread_local sqlite::handle db(":memory:");
-        sqlite::statement stmt(db);
-        std::ifstream ifs(database);
-        std::stringstream buffer;
-        buffer << ifs.rdbuf();
-        stmt.exec(buffer.str());
-        setup(db, database);
-    }
+    setup(getTables(database));
 }
 
-void QuantumDefect::setup(sqlite3 *db, std::string const &db_name) {
-    static Cache<Key, Element, Hash> cache;
-    static std::string used_db_name;
-
-    if (used_db_name != db_name) {
-        used_db_name = db_name;
-        cache.clear(); // Clear cache
-    }
-
-    Key const key{species, n, l, j};
-    if (auto oe = cache.restore(key)) {
-        e = oe.value(); // Restore cache
-        return;         // Return early
-    }
-
-    std::stringstream ss;
-    sqlite::statement stmt(db);
-    int pot_max_l, ryd_max_l;
-    int pot_l, ryd_l;
-    double ryd_max_j;
-    double ryd_j;
-
-    // Determine maximal L for model potentials
-    stmt.set("select MAX(L) from model_potential where (element = ?);");
-    stmt.prepare();
-    stmt.bind(1, species);
-    if (stmt.step()) {
-        pot_max_l = stmt.get<int>(0);
-    } else {
+void QuantumDefect::setup(Tables const &tables) {
+    auto it = tables.species.find(species);
+    if (it == tables.species.end() || it->second.model_potential.empty()) {
         throw no_potential(*this);
     }
-
-    // The l to be used is the minimum of the two below
-    pot_l = std::min(l, pot_max_l);
-
-    // Determine maximal L for Rydberg-Ritz coefficients
-    stmt.reset();
-    stmt.set("select MAX(L) from rydberg_ritz where (element = ?);");
-    stmt.prepare();
-    stmt.bind(1, species);
-    if (stmt.step()) {
-        ryd_max_l = stmt.get<int>(0);
-    } else {
+    auto const &model_potential = it->second.model_potential;
+    auto const &rydberg_ritz = it->second.rydberg_ritz;
+
+    // Determine maximal L for model potentials, the l to be used is the minimum of the two
+    int pot_max_l = std::max_element(model_potential.begin(), model_potential.end(),
+                                     [](auto const &a, auto const &b) { return a.L < b.L; })
+                        ->L;
+    int pot_l = std::min(l, pot_max_l);
+
+    // Determine maximal L for Rydberg-Ritz coefficients, the l to be used is the minimum of the
+    // two
+    if (rydberg_ritz.empty()) {
         throw no_defect(*this);
     }
-
-    // The l to be used is the minimum of the two below
-    ryd_l = std::min(l, ryd_max_l);
-
-    // Determine maximal J for Rydberg-Ritz coefficients
-    stmt.reset();
-    stmt.set("select MAX(J) from rydberg_ritz where  ((element = ?1) and (L = "
-             "?2));");
-    stmt.prepare();
-    stmt.bind(1, species);
-    stmt.bind(2, ryd_l);
-    if (stmt.step()) {
-        ryd_max_j = stmt.get<double>(0);
-    } else {
-        throw no_defect(*this);
+    int ryd_max_l = std::max_element(rydberg_ritz.begin(), rydberg_ritz.end(),
+                                     [](auto const &a, auto const &b) { return a.L < b.L; })
+                        ->L;
+    int ryd_l = std::min(l, ryd_max_l);
+
+    // Determine maximal J for Rydberg-Ritz coefficients, the j to be used is the minimum of the
+    // two
+    double ryd_max_j = 0;
+    for (auto const &row : rydberg_ritz) {
+        if (row.L == ryd_l) {
+            ryd_max_j = std::max(ryd_max_j, row.J);
+        }
     }
+    double ryd_j = std::min(j, ryd_max_j);
 
-    // The j to be used is the minimum of the two below
-    ryd_j = std::min(j, ryd_max_j);
-
-    // Load model potentials from database
-    stmt.reset();
-    stmt.set("select ac,Z,a1,a2,a3,a4,rc from model_potential where ((element "
-             "= ?1) and (L = ?2));");
-    stmt.prepare();
-    stmt.bind(1, species);
-    stmt.bind(2, pot_l);
-    if (stmt.step()) {
-        e.ac = stmt.get<double>(0);
-        e.Z = stmt.get<int>(1);
-        e.a1 = stmt.get<double>(2);
-        e.a2 = stmt.get<double>(3);
-        e.a3 = stmt.get<double>(4);
-        e.a4 = stmt.get<double>(5);
-        e.rc = stmt.get<double>(6);
-    } else {
+    // Load model potentials
+    auto pot = std::find_if(model_potential.begin(), model_potential.end(),
+                            [&](auto const &row) { return row.L == pot_l; });
+    if (pot == model_potential.end()) {
         throw no_potential(*this);
     }
-
-    // Load Rydberg-Ritz coefficients from database
-    stmt.reset();
-    stmt.set("select d0,d2,d4,d6,d8,Ry from rydberg_ritz where ((element = ?1) "
-             "and (L = ?2) and (J = ?3));");
-    stmt.prepare();
-    stmt.bind(1, species);
-    stmt.bind(2, ryd_l);
-    stmt.bind(3, ryd_j);
-    e.nstar = n;
-    double Ry_inf = 109737.31568525;
-    double Ry;
-    if (stmt.step()) {
-        double d0 = stmt.get<double>(0);
-        double d2 = stmt.get<double>(1);
-        double d4 = stmt.get<double>(2);
-        double d6 = stmt.get<double>(3);
-        double d8 = stmt.get<double>(4);
-        Ry = stmt.get<double>(5);
-        e.nstar -= d0 + d2 / pow(n - d0, 2) + d4 / pow(n - d0, 4) + d6 / pow(n - d0, 6) +
-            d8 / pow(n - d0, 8);
-    } else {
+    e.ac = pot->ac;
+    e.Z = pot->Z;
+    e.a1 = pot->a1;
+    e.a2 = pot->a2;
+    e.a3 = pot->a3;
+    e.a4 = pot->a4;
+    e.rc = pot->rc;
+
+    // Load Rydberg-Ritz coefficients
+    auto ryd = std::find_if(rydberg_ritz.begin(), rydberg_ritz.end(),
+                            [&](auto const &row) { return row.L == ryd_l && row.J == ryd_j; });
+    if (ryd == rydberg_ritz.end()) {
         throw no_defect(*this);
     }
+    double d0 = ryd->d0;
+    e.nstar = n;
+    e.nstar -= d0 + ryd->d2 / pow(n - d0, 2) + ryd->d4 / pow(n - d0, 4) +
+        ryd->d6 / pow(n - d0, 6) + ryd->d8 / pow(n - d0, 8);
 
-    e.energy = -.5 * (Ry / Ry_inf) / (e.nstar * e.nstar) * au2GHz;
-
-    cache.save(key, e);
+    double Ry_inf = 109737.31568525;
+    e.energy = -.5 * (ryd->Ry / Ry_inf) / (e.nstar * e.nstar) * au2GHz;
 }
 
 double energy_level(std::string const &species, int n, int l, double j,
@@ -20,21 +20,21 @@
 #ifndef QUANTUM_DEFECT_H
 #define QUANTUM_DEFECT_H
 
-#include "Cache.hpp"
-#include "SQLite.hpp"
 #include "dtypes.hpp"
-#include "utils.hpp"
 
-#include <mutex>
+#include <cstddef>
 #include <string>
-#include <tuple>
-#include <unordered_map>
 
 /** \brief Quantum defect storage
  *
- * The quantum defect queries a database for Rydberg-Ritz coefficients and
- * model potential parameters. The Rydberg-Ritz coefficients are not exposed to
- * the outside but included in the energy data member.
+ * The quantum defect looks up Rydberg-Ritz coefficients and model potential
+ * parameters in the tables of a database. The Rydberg-Ritz coefficients are not
+ * exposed to the outside but included in the energy data member.
+ *
+ * The tables of the default database are generated from its SQL script at
+ * build time. A user-defined database is loaded once per process into tables
+ * of the same structure. The tables are immutable so that they are read by
+ * several threads without locking.
  *
  * The slight deviation from the hydrogen atom for Rydberg atoms are captured
  * in the so-called quantum defect. The hydrogen energy is given by \f$ E =
@@ -56,33 +56,10 @@
  */
 class QuantumDefect {
 private:
-    /** \brief Key type for quantum defect cache */
-    struct Key {
-        std::string species;
-        int n;
-        int l;
-        double j;
-
-        /** \brief Comparison for keys */
-        bool operator==(Key const &o) const {
-            return (species == o.species && n == o.n && l == o.l && j == o.j);
-        }
-    };
-
-    //** \brief Hash for Key */
-    struct Hash {
-        /** \brief Hash the key using utils::hash_combine */
-        std::size_t operator()(Key const &key) const {
-            std::size_t seed = 0;
-            utils::hash_combine(seed, key.species);
-            utils::hash_combine(seed, key.n);
-            utils::hash_combine(seed, key.l);
-            utils::hash_combine(seed, key.j);
-            return seed;
-        }
-    };
+    /** \brief Tables of a database, grouped by species */
+    struct Tables;
 
-    /** \brief Element in the quantum defect cache */
+    /** \brief Parameters of the state */
     struct Element {
         double ac;
         int Z;
@@ -94,14 +71,15 @@ private:
 
     Element e;
 
-    void setup(sqlite3 * /*db*/, std::string const &db_name);
+    void setup(Tables const &tables);
+    static Tables const &getTables(std::string const &database);
 
     QuantumDefect(std::string _species, int _n, int _l, double _j, std::nullptr_t);
 
 public:
     /** \brief Constructor
      *
-     * Save the input and query the database.
+     * Save the input and look up the parameters in the default database.
      *
      * \param[in] species   atomic species of the atom
      * \param[in] n         principal quantum number
@@ -156,10 +134,9 @@ public:
 
 /** \brief Returns only the energy of a state
  *
- * \warning This function has a considerable overhead because it allocates a new
- * quantum defect which triggers a database query. Use this function only for
- * debugging because many successive calls to this will cause a massive slow
- * down.
+ * \warning This function constructs a new quantum defect on every call. If
+ * several properties of a state are needed, construct the quantum defect
+ * once.
  *
  * \param[in] species   atomic species of the atom
  * \param[in] n         principal quantum number
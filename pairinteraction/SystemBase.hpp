@@ -20,6 +20,7 @@
 #ifndef SYSTEMBASE_H
 #define SYSTEMBASE_H
 
+#include "Eigensolver.hpp"
 #include "MatrixElementCache.hpp"
 #include "State.hpp"
 #include "WignerD.hpp"
@@ -44,12 +45,15 @@
 #include <boost/serialization/complex.hpp>
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/vector.hpp>
+#include <cmath>
 #include <complex>
+#include <exception>
 #include <functional>
 #include <iterator>
 #include <limits>
 #include <memory>
 #include <numeric>
+#include <random>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -124,6 +128,8 @@ public:
 
     void setMinimalNorm(const double &threshold) { threshold_for_sqnorm = threshold; }
 
+    void setMaxNumEigenvaluesPerSlice(const size_t &num) { max_num_eigenvalues_per_slice = num; }
+
     ////////////////////////////////////////////////////////////////////
     /// Methods to restrict the number of states inside the basis //////
     ////////////////////////////////////////////////////////////////////
@@ -538,7 +544,18 @@ public:
     }
 
     void diagonalize(double energy_lower_bound, double energy_upper_bound, double threshold) {
-#ifdef WITH_INTEL_MKL
+        this->diagonalizeWindow(energy_lower_bound, energy_upper_bound, threshold, nullptr);
+    }
+
+    void diagonalize(double energy_lower_bound, double energy_upper_bound, double threshold,
+                     SystemBase<T> &system_previous) {
+        this->diagonalizeWindow(energy_lower_bound, energy_upper_bound, threshold,
+                                &system_previous);
+    }
+
+    void diagonalize() { this->diagonalize(0); }
+
+    void diagonalize(double threshold) {
         this->buildHamiltonian();
 
         // Check if already diagonal
@@ -546,167 +563,124 @@ public:
             return;
         }
 
-        // Estimate number of found eigenvalues
-        std::vector<double> diagonal_max(hamiltonian.outerSize(), 0);
-        std::vector<double> diagonal_val;
-        std::vector<int> diagonal_idx;
-        diagonal_val.reserve(hamiltonian.outerSize());
-        diagonal_idx.reserve(hamiltonian.outerSize());
-        for (int k = 0; k < hamiltonian.outerSize(); ++k) {
-            double val = 0;
-            for (eigen_iterator_t triple(hamiltonian, k); triple; ++triple) {
-                if (triple.row() == triple.col()) {
-                    val = std::real(triple.value());
-                } else if (triple.row() != triple.col()) {
-                    diagonal_max[k] = std::max(diagonal_max[k], std::abs(triple.value()));
-                }
-            }
-            diagonal_idx.push_back(k);
-            diagonal_val.push_back(val);
-        }
+        // Decompose the Hamiltonian into blocks that are not coupled to each other
+        std::vector<std::vector<int>> blocks = eigensolver::findBlocks(hamiltonian);
 
-        MKL_INT m0 =
-            std::count_if(diagonal_val.begin(), diagonal_val.end(),
-                          [&energy_lower_bound, &energy_upper_bound](const double &val) {
-                              return (val < energy_upper_bound) && (val > energy_lower_bound);
-                          }) +
-            std::count_if(diagonal_idx.begin(), diagonal_idx.end(),
-                          [&energy_lower_bound, &energy_upper_bound, &diagonal_val,
-                           &diagonal_max](const int &i) {
-                              return ((diagonal_val[i] >= energy_upper_bound) ||
-                                      (diagonal_val[i] <= energy_lower_bound)) &&
-                                  (diagonal_val[i] < energy_upper_bound + diagonal_max[i]) &&
-                                  (diagonal_val[i] > energy_lower_bound - diagonal_max[i]);
-                          });
-
-        // Inplace conversion of the Hamiltonian to CSR with one-based indexing
-        hamiltonian = hamiltonian.transpose();
-        hamiltonian.makeCompressed();
-        for (int i = 0; i < hamiltonian.rows() + 1; ++i) {
-            hamiltonian.outerIndexPtr()[i] += 1;
-        }
-        for (int i = 0; i < hamiltonian.nonZeros(); ++i) {
-            hamiltonian.innerIndexPtr()[i] += 1;
-        }
+        // Diagonalize the blocks
+        std::vector<eigen_vector_double_t> evals_of_blocks;
+        std::vector<eigen_dense_t> evecs_of_blocks;
+        this->diagonalizeBlocks(blocks, evals_of_blocks, evecs_of_blocks, true);
 
-        // Set default parameters for the diagonalization as described at
-        // https://software.intel.com/en-us/mkl-developer-reference-c-extended-eigensolver-input-parameters.
+        // Transform the hamiltonian and the basis vectors
+        this->applyEigenpairsOfBlocks(blocks, evals_of_blocks, evecs_of_blocks, threshold);
 
-        std::vector<MKL_INT> fpm(128);
-        feastinit(&fpm[0]);
-        fpm[0] = 1;  // enables terminal output
-        fpm[1] = 6;  // number of contour points
-        fpm[26] = 0; // disables matrix checker
-        fpm[3] = 5;  // maximum number of refinement loops allowed
-        if (threshold != 0) {
-            // Adapt the error trace stopping criteria (10-fpm[2])
-            fpm[2] = std::min(std::round(-std::log10(threshold)), 12.);
-        }
-
-        // Do the diagonalization
-        {
-            MKL_INT n = hamiltonian.rows();  // size of the matrix
-            MKL_INT m;                       // will contain the number of eigenvalues
-            std::vector<scalar_t> x(m0 * n); // the first m columns will contain the eigenvectors
-            {
-                std::vector<double> e(m0); // will contain the first m eigenvalues
-                {
-                    char uplo = 'F';             // full matrix is stored
-                    MKL_INT info;                // will contain return codes
-                    double epsout;               // will contain relative error
-                    MKL_INT loop;                // will contain number of used refinement
-                    std::vector<double> res(m0); // will contain the residual errors
-
-                    this->feast_csrev(&uplo, &n, hamiltonian.valuePtr(),
-                                      hamiltonian.outerIndexPtr(), hamiltonian.innerIndexPtr(),
-                                      &fpm[0], &epsout, &loop, &energy_lower_bound,
-                                      &energy_upper_bound, &m0, &e[0], &x[0], &m, &res[0], &info);
-                    if (info != 0) {
-                        throw std::runtime_error("Diagonalization with FEAST failed.");
-                    }
-                }
+        // TODO call transformInteraction (see applyRightsideTransformator), perhaps not?
+    }
 
-                // Build the new hamiltonian
-                hamiltonian.resize(m, m);
-                hamiltonian.setZero();
-                hamiltonian.reserve(m);
-                for (int idx = 0; idx < m; ++idx) {
-                    hamiltonian.insert(idx, idx) = e[idx];
-                }
-                hamiltonian.makeCompressed();
-            }
+    eigen_vector_double_t getEigenvalues() {
+        this->buildHamiltonian();
 
-            // Transform the basis vectors
-            eigen_sparse_t evecs = Eigen::Map<eigen_dense_t>(&x[0], n, m).sparseView();
-            if (threshold == 0) {
-                basisvectors = basisvectors * evecs;
-            } else {
-                basisvectors = (basisvectors * evecs).pruned(threshold, 1);
+        // Get the eigenvalues without calculating eigenvectors, the system is not modified
+        eigen_vector_double_t evals;
+        if (checkIsDiagonal(hamiltonian)) {
+            evals = hamiltonian.diagonal().real();
+        } else {
+            std::vector<std::vector<int>> blocks = eigensolver::findBlocks(hamiltonian);
+            std::vector<eigen_vector_double_t> evals_of_blocks;
+            std::vector<eigen_dense_t> evecs_of_blocks;
+            this->diagonalizeBlocks(blocks, evals_of_blocks, evecs_of_blocks, false);
+
+            evals.resize(hamiltonian.cols());
+            int idx = 0;
+            for (const auto &evals_of_block : evals_of_blocks) {
+                evals.segment(idx, evals_of_block.size()) = evals_of_block;
+                idx += evals_of_block.size();
             }
         }
-#else  // WITH_INTEL_MKL
-        (void)energy_lower_bound;
-        (void)energy_upper_bound;
-        (void)threshold;
-        throw std::runtime_error(
-            "The method does not work because the program was compiled without MKL support.");
-#endif // WITH_INTEL_MKL
+
+        std::sort(evals.data(), evals.data() + evals.size());
+        return evals;
     }
 
-    void diagonalize() { this->diagonalize(0); }
+    void diagonalizeRange(double energy_lower_bound, double energy_upper_bound) {
+        this->diagonalizeRange(energy_lower_bound, energy_upper_bound, 0);
+    }
 
-    void diagonalize(double threshold) {
+    void diagonalizeRange(double energy_lower_bound, double energy_upper_bound,
+                          double threshold) {
         this->buildHamiltonian();
 
-        // Check if already diagonal
-        if (checkIsDiagonal(hamiltonian)) {
-            return;
-        }
+        // Decompose the Hamiltonian into blocks that are not coupled to each other
+        std::vector<std::vector<int>> blocks = eigensolver::findBlocks(hamiltonian);
 
-#if defined EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+        // Diagonalize the blocks, only the eigenpairs within the energy window are calculated
+        std::vector<eigen_vector_double_t> evals_of_blocks;
+        std::vector<eigen_dense_t> evecs_of_blocks;
+        this->diagonalizeBlocks(blocks, evals_of_blocks, evecs_of_blocks, true,
+                                [&](size_t /*b*/, eigen_dense_t &mat, eigen_vector_double_t &evals) {
+                                    this->diagonalizeDenseSelection(mat, evals, 'V',
+                                                                    energy_lower_bound,
+                                                                    energy_upper_bound, 0, 0);
+                                });
 
-        // Diagonalize hamiltonian
-        char jobz = 'V';                 // eigenvalues and eigenvectors are computed
-        char uplo = 'U';                 // full matrix is stored, upper is used
-        int n = hamiltonian.cols();      // size of the matrix
-        eigen_dense_t mat = hamiltonian; // matrix
-        int lda = mat.outerStride();     // leading dimension
-        eigen_vector_double_t evals(n);  // eigenvalues
-        int info = LAPACKE_evd(LAPACK_COL_MAJOR, jobz, uplo, n, mat.data(), lda, evals.data());
-        if (info != 0) {
-            throw std::runtime_error("Diagonalization with LAPACKE failed.");
-        }
+        // Transform the hamiltonian and the basis vectors
+        this->applyEigenpairsOfBlocks(blocks, evals_of_blocks, evecs_of_blocks, threshold);
+    }
 
-        // Get eigenvectors
-        eigen_sparse_t evecs = mat.sparseView();
+    void diagonalizeIndexRange(size_t index_lower, size_t index_upper) {
+        this->diagonalizeIndexRange(index_lower, index_upper, 0);
+    }
 
-#else // EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+    void diagonalizeIndexRange(size_t index_lower, size_t index_upper, double threshold) {
+        this->buildHamiltonian();
 
-        // Diagonalize hamiltonian
-        Eigen::SelfAdjointEigenSolver<eigen_dense_t> eigensolver(hamiltonian);
+        if (index_lower > index_upper || index_upper >= static_cast<size_t>(hamiltonian.cols())) {
+            throw std::runtime_error("The index range of the eigenvalues is invalid.");
+        }
 
-        // Get eigenvalues and eigenvectors
-        eigen_vector_double_t evals = eigensolver.eigenvalues();
-        eigen_sparse_t evecs = eigensolver.eigenvectors().sparseView();
+        // Decompose the Hamiltonian into blocks that are not coupled to each other
+        std::vector<std::vector<int>> blocks = eigensolver::findBlocks(hamiltonian);
 
-#endif // EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+        // Determine which eigenpairs of the blocks belong to the index range, for this, the
+        // eigenvalues of all blocks are needed (the selected eigenpairs of a block have
+        // consecutive indices as the eigenvalues of a block are sorted)
+        std::vector<std::pair<int, int>> index_range_of_blocks(blocks.size());
+        if (blocks.size() == 1) {
+            index_range_of_blocks[0] = {index_lower, index_upper};
+        } else {
+            std::vector<eigen_vector_double_t> evals_of_blocks;
+            std::vector<eigen_dense_t> evecs_of_blocks;
+            this->diagonalizeBlocks(blocks, evals_of_blocks, evecs_of_blocks, false);
 
-        // Build the new hamiltonian
-        hamiltonian.setZero();
-        hamiltonian.reserve(evals.size());
-        for (int idx = 0; idx < evals.size(); ++idx) {
-            hamiltonian.insert(idx, idx) = evals.coeffRef(idx);
+            std::vector<std::pair<size_t, int>> eigenpairs = sortEigenpairs(evals_of_blocks);
+            for (auto &index_range : index_range_of_blocks) {
+                index_range = {std::numeric_limits<int>::max(), -1};
+            }
+            for (size_t idx = index_lower; idx <= index_upper; ++idx) {
+                auto &index_range = index_range_of_blocks[eigenpairs[idx].first];
+                index_range.first = std::min(index_range.first, eigenpairs[idx].second);
+                index_range.second = std::max(index_range.second, eigenpairs[idx].second);
+            }
         }
-        hamiltonian.makeCompressed();
 
-        // Transform the basis vectors
-        if (threshold == 0) {
-            basisvectors = basisvectors * evecs;
-        } else {
-            basisvectors = (basisvectors * evecs).pruned(threshold, 1);
-        }
+        // Diagonalize the blocks, only the selected eigenpairs are calculated
+        std::vector<eigen_vector_double_t> evals_of_blocks;
+        std::vector<eigen_dense_t> evecs_of_blocks;
+        this->diagonalizeBlocks(
+            blocks, evals_of_blocks, evecs_of_blocks, true,
+            [&](size_t b, eigen_dense_t &mat, eigen_vector_double_t &evals) {
+                const auto &index_range = index_range_of_blocks[b];
+                if (index_range.second < 0) {
+                    mat.resize(mat.rows(), 0);
+                    evals.resize(0);
+                    return;
+                }
+                this->diagonalizeDenseSelection(mat, evals, 'I', 0, 0, index_range.first,
+                                                index_range.second);
+            });
 
-        // TODO call transformInteraction (see applyRightsideTransformator), perhaps not?
+        // Transform the hamiltonian and the basis vectors
+        this->applyEigenpairsOfBlocks(blocks, evals_of_blocks, evecs_of_blocks, threshold);
     }
 
     void canonicalize() {
@@ -1234,13 +1208,13 @@ public:
 
 protected:
     SystemBase(MatrixElementCache &cache)
-        : cache(cache), threshold_for_sqnorm(0.05),
+        : cache(cache), threshold_for_sqnorm(0.05), max_num_eigenvalues_per_slice(500),
           energy_min(std::numeric_limits<double>::lowest()),
           energy_max(std::numeric_limits<double>::max()), memory_saving(false),
           is_interaction_already_contained(false), is_new_hamiltonian_required(false) {}
 
     SystemBase(MatrixElementCache &cache, bool memory_saving)
-        : cache(cache), threshold_for_sqnorm(0.05),
+        : cache(cache), threshold_for_sqnorm(0.05), max_num_eigenvalues_per_slice(500),
           energy_min(std::numeric_limits<double>::lowest()),
           energy_max(std::numeric_limits<double>::max()), memory_saving(memory_saving),
           is_interaction_already_contained(false), is_new_hamiltonian_required(false) {}
@@ -1262,6 +1236,7 @@ protected:
     MatrixElementCache &cache;
 
     double threshold_for_sqnorm;
+    size_t max_num_eigenvalues_per_slice;
 
     double energy_min, energy_max;
     std::set<int> range_n, range_l;
@@ -1541,7 +1516,638 @@ private:
     }
 #endif // WITH_INTEL_MKL
 
+    /** \brief Initial subspace of the eigensolver from the previous step of a sweep
+     *
+     * The basis vectors of the previous system are selected by their Rayleigh quotients, i.e. the
+     * diagonal of its Hamiltonian. Vectors within the energy window are preferred to vectors
+     * close to it, vectors that are farther away than the width of the window are not used. At
+     * most num_max vectors are selected and expressed in the current basis, so that the size of
+     * the subspace does not grow with the size of the basis.
+     */
+    eigen_dense_t getInitialSubspace(SystemBase<T> &system_previous, double energy_lower_bound,
+                                     double energy_upper_bound, size_t num_max) {
+        system_previous.buildHamiltonian();
+
+        // Select the basis vectors of the previous system
+        eigen_vector_double_t diagonal = system_previous.hamiltonian.diagonal().real();
+        double width = energy_upper_bound - energy_lower_bound;
+        std::vector<std::pair<double, int>> candidates; // (distance to the window, column)
+        for (int col = 0; col < diagonal.size(); ++col) {
+            double distance = std::max(
+                {energy_lower_bound - diagonal[col], diagonal[col] - energy_upper_bound, 0.});
+            if (distance <= width) {
+                candidates.emplace_back(distance, col);
+            }
+        }
+        std::stable_sort(
+            candidates.begin(), candidates.end(),
+            [](const std::pair<double, int> &a, const std::pair<double, int> &b) {
+                return a.first < b.first;
+            });
+        candidates.resize(std::min(candidates.size(), num_max));
+
+        std::vector<eigen_triplet_t> triplets_selector;
+        triplets_selector.reserve(candidates.size());
+        for (size_t idx = 0; idx < candidates.size(); ++idx) {
+            triplets_selector.emplace_back(candidates[idx].second, idx, 1);
+        }
+        eigen_sparse_t selector(system_previous.basisvectors.cols(), candidates.size());
+        selector.setFromTriplets(triplets_selector.begin(), triplets_selector.end());
+
+        // Calculate transformator between the set of states
+        std::vector<eigen_triplet_t> triplets_transformator;
+        triplets_transformator.reserve(std::min(states.size(), system_previous.states.size()));
+
+        for (const auto &s : system_previous.states) {
+            auto state_iter = states.template get<1>().find(s.state);
+            if (state_iter != states.template get<1>().end()) {
+                size_t idx_from = state_iter->idx;
+                triplets_transformator.emplace_back(idx_from, s.idx, 1);
+            }
+        }
+
+        eigen_sparse_t transformator(states.size(), system_previous.states.size());
+        transformator.setFromTriplets(triplets_transformator.begin(), triplets_transformator.end());
+
+        // Express the selected basis vectors in the current basis
+        eigen_sparse_t selected = system_previous.basisvectors * selector;
+        eigen_sparse_t transformed = transformator * selected;
+        eigen_sparse_t initial_subspace = basisvectors.adjoint() * transformed;
+        return eigen_dense_t(initial_subspace);
+    }
+
+    void diagonalizeWindow(double energy_lower_bound, double energy_upper_bound, double threshold,
+                           SystemBase<T> *system_previous) {
+        this->buildHamiltonian();
+
+        // Check if already diagonal
+        if (checkIsDiagonal(hamiltonian)) {
+            return;
+        }
+
+        // Estimate number of found eigenvalues
+        std::vector<double> diagonal_max(hamiltonian.outerSize(), 0);
+        std::vector<double> diagonal_val;
+        std::vector<int> diagonal_idx;
+        diagonal_val.reserve(hamiltonian.outerSize());
+        diagonal_idx.reserve(hamiltonian.outerSize());
+        for (int k = 0; k < hamiltonian.outerSize(); ++k) {
+            double val = 0;
+            for (eigen_iterator_t triple(hamiltonian, k); triple; ++triple) {
+                if (triple.row() == triple.col()) {
+                    val = std::real(triple.value());
+                } else if (triple.row() != triple.col()) {
+                    diagonal_max[k] = std::max(diagonal_max[k], std::abs(triple.value()));
+                }
+            }
+            diagonal_idx.push_back(k);
+            diagonal_val.push_back(val);
+        }
+
+        auto estimate_num_eigenvalues = [&diagonal_val, &diagonal_idx,
+                                         &diagonal_max](double lower, double upper) -> size_t {
+            return std::count_if(diagonal_val.begin(), diagonal_val.end(),
+                                 [&lower, &upper](const double &val) {
+                                     return (val < upper) && (val > lower);
+                                 }) +
+                std::count_if(diagonal_idx.begin(), diagonal_idx.end(),
+                              [&lower, &upper, &diagonal_val, &diagonal_max](const int &i) {
+                                  return ((diagonal_val[i] >= upper) ||
+                                          (diagonal_val[i] <= lower)) &&
+                                      (diagonal_val[i] < upper + diagonal_max[i]) &&
+                                      (diagonal_val[i] > lower - diagonal_max[i]);
+                              });
+        };
+
+        size_t num_eigenvalues_estimate =
+            estimate_num_eigenvalues(energy_lower_bound, energy_upper_bound);
+
+        // Use the basis vectors of the previous step of the sweep as the initial subspace of the
+        // eigensolver
+        eigen_dense_t initial_subspace;
+        if (system_previous != nullptr) {
+            initial_subspace = this->getInitialSubspace(*system_previous, energy_lower_bound,
+                                                        energy_upper_bound,
+                                                        num_eigenvalues_estimate);
+        }
+
+        // Split the energy window into slices that contain similar numbers of eigenvalues
+        // according to the diagonal of the Hamiltonian
+        std::vector<double> diagonal_val_inside;
+        for (const double &val : diagonal_val) {
+            if ((val < energy_upper_bound) && (val > energy_lower_bound)) {
+                diagonal_val_inside.push_back(val);
+            }
+        }
+        std::sort(diagonal_val_inside.begin(), diagonal_val_inside.end());
+
+        size_t num_slices =
+            std::max<size_t>(1, std::min(diagonal_val_inside.size(),
+                                         num_eigenvalues_estimate /
+                                             std::max<size_t>(1, max_num_eigenvalues_per_slice)));
+
+        // The bounds between the slices are placed into the largest gaps close to the quantiles so
+        // that degenerate eigenvalues are rarely split
+        std::vector<double> slice_bounds({energy_lower_bound});
+        size_t width = std::max<size_t>(1, diagonal_val_inside.size() / (4 * num_slices));
+        for (size_t k = 1; k < num_slices; ++k) {
+            size_t idx_quantile = k * diagonal_val_inside.size() / num_slices;
+            size_t idx_gap = idx_quantile;
+            for (size_t idx = std::max<size_t>(1, idx_quantile - std::min(idx_quantile, width));
+                 idx < std::min(diagonal_val_inside.size(), idx_quantile + width + 1); ++idx) {
+                if (diagonal_val_inside[idx] - diagonal_val_inside[idx - 1] >
+                    diagonal_val_inside[idx_gap] - diagonal_val_inside[idx_gap - 1]) {
+                    idx_gap = idx;
+                }
+            }
+            double bound = 0.5 * (diagonal_val_inside[idx_gap - 1] + diagonal_val_inside[idx_gap]);
+            if (bound > slice_bounds.back()) {
+                slice_bounds.push_back(bound);
+            }
+        }
+        slice_bounds.push_back(energy_upper_bound);
+        num_slices = slice_bounds.size() - 1;
+
+        // Assign the vectors of the initial subspace to the slices by their expectation values
+        std::vector<std::vector<int>> initial_cols_of_slices(num_slices);
+        if (initial_subspace.cols() > 0) {
+            eigen_dense_t hamiltonian_initial_subspace = hamiltonian * initial_subspace;
+            for (int col = 0; col < initial_subspace.cols(); ++col) {
+                double norm = initial_subspace.col(col).squaredNorm();
+                if (norm == 0) {
+                    continue;
+                }
+                double val =
+                    std::real(initial_subspace.col(col).dot(hamiltonian_initial_subspace.col(col))) /
+                    norm;
+                size_t slice = std::upper_bound(slice_bounds.begin() + 1, slice_bounds.end() - 1,
+                                                val) -
+                    (slice_bounds.begin() + 1);
+                initial_cols_of_slices[slice].push_back(col);
+            }
+            for (size_t slice = 0; slice < num_slices; ++slice) {
+                auto &initial_cols = initial_cols_of_slices[slice];
+                initial_cols.resize(std::min(
+                    initial_cols.size(),
+                    estimate_num_eigenvalues(slice_bounds[slice], slice_bounds[slice + 1])));
+            }
+        }
+
+#ifdef WITH_INTEL_MKL
+        // Conversion of the Hamiltonian to CSR with one-based indexing
+        eigen_sparse_t mat = hamiltonian.transpose();
+        mat.makeCompressed();
+        for (int i = 0; i < mat.rows() + 1; ++i) {
+            mat.outerIndexPtr()[i] += 1;
+        }
+        for (int i = 0; i < mat.nonZeros(); ++i) {
+            mat.innerIndexPtr()[i] += 1;
+        }
+#else  // WITH_INTEL_MKL
+        const eigen_sparse_t &mat = hamiltonian;
+#endif // WITH_INTEL_MKL
+
+        // Diagonalize the slices in parallel
+        std::vector<eigensolver::Eigenpairs<scalar_t>> eigenpairs_of_slices(num_slices);
+        std::exception_ptr exception = nullptr;
+
+#pragma omp parallel
+#pragma omp single
+        for (size_t slice = 0; slice < num_slices; ++slice) {
+#pragma omp task firstprivate(slice)
+            {
+                try {
+                    const auto &initial_cols = initial_cols_of_slices[slice];
+                    eigen_dense_t initial_subspace_of_slice(initial_subspace.rows(),
+                                                            initial_cols.size());
+                    for (size_t i = 0; i < initial_cols.size(); ++i) {
+                        initial_subspace_of_slice.col(i) = initial_subspace.col(initial_cols[i]);
+                    }
+                    eigenpairs_of_slices[slice] = this->diagonalizeSlice(
+                        mat, slice_bounds[slice], slice_bounds[slice + 1], threshold,
+                        estimate_num_eigenvalues(slice_bounds[slice], slice_bounds[slice + 1]),
+                        initial_subspace_of_slice);
+                } catch (...) {
+#pragma omp critical(exception)
+                    exception = std::current_exception();
+                }
+            }
+        }
+
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+
+        // Merge the eigenpairs of the slices, sorted by their eigenvalues. Eigenpairs close to a
+        // bound between two slices might have been found by both slices. They are identified by
+        // projecting onto the eigenvectors close to the bound that have been accepted already.
+        std::vector<std::pair<size_t, int>> eigenpairs; // (slice, local index of eigenpair)
+        for (size_t slice = 0; slice < num_slices; ++slice) {
+            for (int i = 0; i < eigenpairs_of_slices[slice].values.size(); ++i) {
+                eigenpairs.emplace_back(slice, i);
+            }
+        }
+        std::stable_sort(eigenpairs.begin(), eigenpairs.end(),
+                         [&eigenpairs_of_slices](const std::pair<size_t, int> &a,
+                                                 const std::pair<size_t, int> &b) {
+                             return eigenpairs_of_slices[a.first].values[a.second] <
+                                 eigenpairs_of_slices[b.first].values[b.second];
+                         });
+
+        double tolerance_bounds = 1e-6 * eigensolver::normOne(hamiltonian);
+        std::vector<eigen_dense_t> accepted_close_to_bounds(
+            slice_bounds.size(), eigen_dense_t(hamiltonian.rows(), 0));
+
+        std::vector<std::pair<size_t, int>> eigenpairs_unique;
+        eigenpairs_unique.reserve(eigenpairs.size());
+        for (const auto &eigenpair : eigenpairs) {
+            const auto &eigenpairs_of_slice = eigenpairs_of_slices[eigenpair.first];
+            double val = eigenpairs_of_slice.values[eigenpair.second];
+
+            // Index k of the closest bound between two slices, i.e. slice_bounds[k]
+            size_t k = std::lower_bound(slice_bounds.begin() + 1, slice_bounds.end() - 1, val) -
+                slice_bounds.begin();
+            if (k > 1 && val - slice_bounds[k - 1] < slice_bounds[k] - val) {
+                --k;
+            }
+
+            if (num_slices > 1 && std::abs(val - slice_bounds[k]) <= tolerance_bounds) {
+                auto &accepted = accepted_close_to_bounds[k];
+                eigen_dense_t residual = eigenpairs_of_slice.vectors.col(eigenpair.second);
+                residual -= accepted * (accepted.adjoint() * residual);
+                double norm = residual.norm();
+                if (norm < 0.5) {
+                    continue;
+                }
+                accepted.conservativeResize(accepted.rows(), accepted.cols() + 1);
+                accepted.col(accepted.cols() - 1) = residual / norm;
+            }
+            eigenpairs_unique.push_back(eigenpair);
+        }
+
+        int m = eigenpairs_unique.size();
+
+        // Build the new hamiltonian
+        hamiltonian.resize(m, m);
+        hamiltonian.setZero();
+        hamiltonian.reserve(m);
+        for (int idx = 0; idx < m; ++idx) {
+            hamiltonian.insert(idx, idx) =
+                eigenpairs_of_slices[eigenpairs_unique[idx].first]
+                    .values[eigenpairs_unique[idx].second];
+        }
+        hamiltonian.makeCompressed();
+
+        // Transform the basis vectors
+        eigen_dense_t evecs_dense(basisvectors.cols(), m);
+        for (int idx = 0; idx < m; ++idx) {
+            evecs_dense.col(idx) = eigenpairs_of_slices[eigenpairs_unique[idx].first].vectors.col(
+                eigenpairs_unique[idx].second);
+        }
+        eigenpairs_of_slices.clear();
+
+        eigen_sparse_t evecs = evecs_dense.sparseView();
+        if (threshold == 0) {
+            basisvectors = basisvectors * evecs;
+        } else {
+            basisvectors = (basisvectors * evecs).pruned(threshold, 1);
+        }
+    }
+
+    eigensolver::Eigenpairs<scalar_t> diagonalizeSlice(const eigen_sparse_t &mat,
+                                                       double energy_lower_bound,
+                                                       double energy_upper_bound, double threshold,
+                                                       size_t num_eigenvalues_estimate,
+                                                       const eigen_dense_t &initial_subspace) {
+        eigensolver::Eigenpairs<scalar_t> eigenpairs;
+
+#ifdef WITH_INTEL_MKL
+        MKL_INT m0 = std::max<size_t>(num_eigenvalues_estimate, initial_subspace.cols());
+
+        // Set default parameters for the diagonalization as described at
+        // https://software.intel.com/en-us/mkl-developer-reference-c-extended-eigensolver-input-parameters.
+
+        std::vector<MKL_INT> fpm(128);
+        feastinit(&fpm[0]);
+        fpm[0] = 0;  // disables terminal output, the slices are diagonalized concurrently
+        fpm[1] = 6;  // number of contour points
+        fpm[26] = 0; // disables matrix checker
+        fpm[3] = 5;  // maximum number of refinement loops allowed
+        if (threshold != 0) {
+            // Adapt the error trace stopping criteria (10-fpm[2])
+            fpm[2] = std::min(std::round(-std::log10(threshold)), 12.);
+        }
+        if (initial_subspace.cols() > 0) {
+            fpm[4] = 1; // use the initial subspace
+        }
+
+        // Do the diagonalization
+        MKL_INT n = mat.rows();          // size of the matrix
+        MKL_INT m;                       // will contain the number of eigenvalues
+        std::vector<scalar_t> x(m0 * n); // the first m columns will contain the eigenvectors
+        std::vector<double> e(m0);       // will contain the first m eigenvalues
+
+        // Fill in the initial subspace, complemented by random vectors
+        if (initial_subspace.cols() > 0) {
+            std::default_random_engine engine(0);
+            std::normal_distribution<double> distribution;
+            for (auto &val : x) {
+                val = distribution(engine);
+            }
+            Eigen::Map<eigen_dense_t>(&x[0], n, m0).leftCols(initial_subspace.cols()) =
+                initial_subspace;
+        }
+
+        {
+            char uplo = 'F';             // full matrix is stored
+            MKL_INT info;                // will contain return codes
+            double epsout;               // will contain relative error
+            MKL_INT loop;                // will contain number of used refinement
+            std::vector<double> res(m0); // will contain the residual errors
+
+            this->feast_csrev(&uplo, &n, mat.valuePtr(), mat.outerIndexPtr(),
+                              mat.innerIndexPtr(), &fpm[0], &epsout, &loop, &energy_lower_bound,
+                              &energy_upper_bound, &m0, &e[0], &x[0], &m, &res[0], &info);
+            if (info != 0) {
+                throw std::runtime_error("Diagonalization with FEAST failed.");
+            }
+        }
+
+        eigenpairs.values = Eigen::Map<eigen_vector_double_t>(&e[0], m);
+        eigenpairs.vectors = Eigen::Map<eigen_dense_t>(&x[0], n, m);
+#else  // WITH_INTEL_MKL
+        (void)threshold;
+        (void)num_eigenvalues_estimate;
+
+        // Do the diagonalization using the shift-invert block Lanczos method
+        eigenpairs = eigensolver::shiftInvertLanczos(mat, energy_lower_bound, energy_upper_bound,
+                                                     initial_subspace);
+#endif // WITH_INTEL_MKL
+
+        return eigenpairs;
+    }
+
+    void diagonalizeBlocks(const std::vector<std::vector<int>> &blocks,
+                           std::vector<eigen_vector_double_t> &evals_of_blocks,
+                           std::vector<eigen_dense_t> &evecs_of_blocks,
+                           bool compute_eigenvectors) {
+        this->diagonalizeBlocks(
+            blocks, evals_of_blocks, evecs_of_blocks, compute_eigenvectors,
+            [&](size_t /*b*/, eigen_dense_t &mat, eigen_vector_double_t &evals) {
+                this->diagonalizeDense(mat, evals, compute_eigenvectors);
+            });
+    }
+
+    template <class F>
+    void diagonalizeBlocks(const std::vector<std::vector<int>> &blocks,
+                           std::vector<eigen_vector_double_t> &evals_of_blocks,
+                           std::vector<eigen_dense_t> &evecs_of_blocks, bool compute_eigenvectors,
+                           F &&diagonalize_block) {
+        std::vector<int> local_index(hamiltonian.cols());
+        for (const auto &block : blocks) {
+            for (size_t i = 0; i < block.size(); ++i) {
+                local_index[block[i]] = i;
+            }
+        }
+
+        // Diagonalize the blocks in parallel, starting with the largest ones
+        std::vector<size_t> order(blocks.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&blocks](size_t a, size_t b) {
+            return blocks[a].size() > blocks[b].size();
+        });
+
+        evals_of_blocks.assign(blocks.size(), eigen_vector_double_t());
+        evecs_of_blocks.assign(compute_eigenvectors ? blocks.size() : 0, eigen_dense_t());
+        std::exception_ptr exception = nullptr;
+
+#pragma omp parallel
+#pragma omp single
+        for (size_t b : order) {
+#pragma omp task firstprivate(b)
+            {
+                try {
+                    const auto &block = blocks[b];
+                    eigen_dense_t mat = eigen_dense_t::Zero(block.size(), block.size());
+                    for (size_t i = 0; i < block.size(); ++i) {
+                        for (eigen_iterator_t triple(hamiltonian, block[i]); triple; ++triple) {
+                            mat(local_index[triple.row()], i) = triple.value();
+                        }
+                    }
+                    diagonalize_block(b, mat, evals_of_blocks[b]);
+                    if (compute_eigenvectors) {
+                        evecs_of_blocks[b] = std::move(mat);
+                    }
+                } catch (...) {
+#pragma omp critical(exception)
+                    exception = std::current_exception();
+                }
+            }
+        }
+
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    static std::vector<std::pair<size_t, int>>
+    sortEigenpairs(const std::vector<eigen_vector_double_t> &evals_of_blocks) {
+        std::vector<std::pair<size_t, int>> eigenpairs; // (block, local index of eigenpair)
+        for (size_t b = 0; b < evals_of_blocks.size(); ++b) {
+            for (int i = 0; i < evals_of_blocks[b].size(); ++i) {
+                eigenpairs.emplace_back(b, i);
+            }
+        }
+        std::stable_sort(eigenpairs.begin(), eigenpairs.end(),
+                         [&evals_of_blocks](const std::pair<size_t, int> &a,
+                                            const std::pair<size_t, int> &b) {
+                             return evals_of_blocks[a.first][a.second] <
+                                 evals_of_blocks[b.first][b.second];
+                         });
+        return eigenpairs;
+    }
+
+    void applyEigenpairsOfBlocks(const std::vector<std::vector<int>> &blocks,
+                                 std::vector<eigen_vector_double_t> &evals_of_blocks,
+                                 std::vector<eigen_dense_t> &evecs_of_blocks, double threshold) {
+        // Sort the eigenpairs of all blocks by their eigenvalues
+        std::vector<std::pair<size_t, int>> eigenpairs = sortEigenpairs(evals_of_blocks);
+
+        // Build the new hamiltonian and the eigenvectors, the rows of the eigenvectors are already
+        // sorted as the indices within a block are sorted
+        eigen_sparse_t evecs(hamiltonian.rows(), eigenpairs.size());
+        size_t nnz = 0;
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            nnz += blocks[b].size() * evals_of_blocks[b].size();
+        }
+        evecs.reserve(nnz);
+
+        hamiltonian.resize(eigenpairs.size(), eigenpairs.size());
+        hamiltonian.reserve(eigenpairs.size());
+        for (size_t idx = 0; idx < eigenpairs.size(); ++idx) {
+            size_t b = eigenpairs[idx].first;
+            int i = eigenpairs[idx].second;
+            hamiltonian.insert(idx, idx) = evals_of_blocks[b].coeffRef(i);
+            evecs.startVec(idx);
+            for (size_t r = 0; r < blocks[b].size(); ++r) {
+                scalar_t val = evecs_of_blocks[b](r, i);
+                if (val != scalar_t(0)) {
+                    evecs.insertBack(blocks[b][r], idx) = val;
+                }
+            }
+        }
+        evecs.finalize();
+        hamiltonian.makeCompressed();
+
+        evals_of_blocks.clear();
+        evecs_of_blocks.clear();
+
+        // Transform the basis vectors
+        if (threshold == 0) {
+            basisvectors = basisvectors * evecs;
+        } else {
+            basisvectors = (basisvectors * evecs).pruned(threshold, 1);
+        }
+    }
+
+    void diagonalizeDense(eigen_dense_t &mat, eigen_vector_double_t &evals,
+                          bool compute_eigenvectors) {
+#if defined EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+
+        // Diagonalize matrix, the matrix gets overwritten by the eigenvectors
+        char jobz = compute_eigenvectors ? 'V' : 'N'; // whether eigenvectors are computed
+        char uplo = 'U';                              // full matrix is stored, upper is used
+        int n = mat.cols();                           // size of the matrix
+        int lda = mat.outerStride();                  // leading dimension
+        evals.resize(n);                              // eigenvalues
+        int info = LAPACKE_evd(LAPACK_COL_MAJOR, jobz, uplo, n, mat.data(), lda, evals.data());
+        if (info != 0) {
+            throw std::runtime_error("Diagonalization with LAPACKE failed.");
+        }
+
+#else // EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+
+        // Diagonalize matrix
+        Eigen::SelfAdjointEigenSolver<eigen_dense_t> eigensolver(
+            mat, compute_eigenvectors ? Eigen::ComputeEigenvectors : Eigen::EigenvaluesOnly);
+
+        // Get eigenvalues and eigenvectors
+        evals = eigensolver.eigenvalues();
+        if (compute_eigenvectors) {
+            mat = eigensolver.eigenvectors();
+        }
+
+#endif // EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+    }
+
+    void diagonalizeDenseSelection(eigen_dense_t &mat, eigen_vector_double_t &evals, char range,
+                                   double energy_lower_bound, double energy_upper_bound,
+                                   int index_lower, int index_upper) {
+#if defined EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+
+        // Reduce the matrix to tridiagonal form, the Householder reflectors are stored in the
+        // upper triangle of the matrix
+        char uplo = 'U';             // full matrix is stored, upper is used
+        int n = mat.cols();          // size of the matrix
+        int lda = mat.outerStride(); // leading dimension
+        eigen_vector_double_t diagonal(n);
+        eigen_vector_double_t subdiagonal(std::max(n, 1)); // ?stemr needs n elements
+        std::vector<scalar_t> tau(std::max(n - 1, 1));
+        int info = LAPACKE_trd(LAPACK_COL_MAJOR, uplo, n, mat.data(), lda, diagonal.data(),
+                               subdiagonal.data(), tau.data());
+        if (info != 0) {
+            throw std::runtime_error("Tridiagonalization with LAPACKE failed.");
+        }
+
+        // In case of an energy window, the eigenvalues within (lower, upper] are counted by the
+        // Sturm sequence of the tridiagonal matrix, so that only the memory for their
+        // eigenvectors is allocated
+        if (range == 'V') {
+            double max_subdiagonal_squared = 1;
+            for (int i = 0; i < n - 1; ++i) {
+                max_subdiagonal_squared =
+                    std::max(max_subdiagonal_squared, subdiagonal[i] * subdiagonal[i]);
+            }
+            const double pivmin = std::numeric_limits<double>::min() * max_subdiagonal_squared;
+            const double infinity = std::numeric_limits<double>::infinity();
+            index_lower = eigensolver::countEigenvaluesBelow(
+                diagonal, subdiagonal, std::nextafter(energy_lower_bound, infinity), pivmin);
+            index_upper = eigensolver::countEigenvaluesBelow(
+                              diagonal, subdiagonal, std::nextafter(energy_upper_bound, infinity),
+                              pivmin) -
+                1;
+        }
+        if (index_upper < index_lower) {
+            evals.resize(0);
+            mat.resize(mat.rows(), 0);
+            return;
+        }
+
+        // Calculate the selected eigenpairs of the tridiagonal matrix
+        int m0 = index_upper - index_lower + 1;
+        lapack_int m = 0; // number of found eigenvalues
+        lapack_logical tryrac = 1;
+        eigen_vector_double_t w(n);
+        eigen_dense_double_t z(n, m0);
+        std::vector<lapack_int> isuppz(2 * m0);
+        info = LAPACKE_dstemr(LAPACK_COL_MAJOR, 'V', 'I', n, diagonal.data(), subdiagonal.data(),
+                              energy_lower_bound, energy_upper_bound, index_lower + 1,
+                              index_upper + 1, &m, w.data(), z.data(), n, m0, isuppz.data(),
+                              &tryrac);
+        if (info != 0) {
+            throw std::runtime_error("Diagonalization with LAPACKE failed.");
+        }
+
+        // Transform the eigenvectors back
+        eigen_dense_t evecs = z.leftCols(m).cast<scalar_t>();
+        info = LAPACKE_mtr(LAPACK_COL_MAJOR, 'L', uplo, 'N', n, m, mat.data(), lda, tau.data(),
+                           evecs.data(), n);
+        if (info != 0) {
+            throw std::runtime_error("Back transformation with LAPACKE failed.");
+        }
+
+        // Get eigenvalues and eigenvectors
+        evals = w.head(m);
+        mat = std::move(evecs);
+
+#else // EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+
+        // Diagonalize matrix, only the selected eigenpairs are calculated
+        eigensolver::Eigenpairs<scalar_t> eigenpairs = eigensolver::bisection(
+            mat, range, energy_lower_bound, energy_upper_bound, index_lower, index_upper);
+
+        // Get eigenvalues and eigenvectors
+        evals = std::move(eigenpairs.values);
+        mat = std::move(eigenpairs.vectors);
+
+#endif // EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+    }
+
 #if defined EIGEN_USE_LAPACKE || WITH_INTEL_MKL
+    int LAPACKE_trd(const int matrix_layout, const char uplo, const lapack_int n, double *a,
+                    const lapack_int lda, double *d, double *e, double *tau) {
+        return LAPACKE_dsytrd(matrix_layout, uplo, n, a, lda, d, e, tau);
+    }
+
+    int LAPACKE_trd(const int matrix_layout, const char uplo, const lapack_int n,
+                    lapack_complex_double *a, const lapack_int lda, double *d, double *e,
+                    lapack_complex_double *tau) {
+        return LAPACKE_zhetrd(matrix_layout, uplo, n, a, lda, d, e, tau);
+    }
+
+    int LAPACKE_mtr(const int matrix_layout, const char side, const char uplo, const char trans,
+                    const lapack_int m, const lapack_int n, const double *a, const lapack_int lda,
+                    const double *tau, double *c, const lapack_int ldc) {
+        return LAPACKE_dormtr(matrix_layout, side, uplo, trans, m, n, a, lda, tau, c, ldc);
+    }
+
+    int LAPACKE_mtr(const int matrix_layout, const char side, const char uplo, const char trans,
+                    const lapack_int m, const lapack_int n, const lapack_complex_double *a,
+                    const lapack_int lda, const lapack_complex_double *tau,
+                    lapack_complex_double *c, const lapack_int ldc) {
+        return LAPACKE_zunmtr(matrix_layout, side, uplo, trans, m, n, a, lda, tau, c, ldc);
+    }
+
     int LAPACKE_evd(const int matrix_layout, const char jobz, const char uplo, const lapack_int n,
                     double *a, const lapack_int lda, double *w) {
         return LAPACKE_dsyevd(matrix_layout, jobz, uplo, n, a, lda, w);
@@ -1643,7 +2249,7 @@ private:
 
     template <class Archive>
     void serialize(Archive &ar, const unsigned int /*version*/) {
-        ar &cache &threshold_for_sqnorm;
+        ar &cache &threshold_for_sqnorm &max_num_eigenvalues_per_slice;
         ar &energy_min &energy_max &range_n &range_l &range_j &range_m &states_to_add;
         ar &memory_saving &is_interaction_already_contained &is_new_hamiltonian_required;
         ar &states &basisvectors &hamiltonian;
@@ -20,6 +20,7 @@
 #include "SystemOne.hpp"
 #include "dtypes.hpp"
 
+#include <algorithm>
 #include <cctype>
 #include <cmath>
 #include <limits>
@@ -383,87 +384,182 @@ void SystemOne::initializeInteraction() {
         }
     }
 
+    // Calculate the missing matrix elements now, so that the parallelized loop below only reads
+    // from the cache
+    cache.update();
+
     ////////////////////////////////////////////////////////////////////
-    /// Calculate the interaction in the canonical basis ///////////////
+    /// Index the states by their angular quantum numbers //////////////
     ////////////////////////////////////////////////////////////////////
 
-    std::unordered_map<int, std::vector<eigen_triplet_t>>
-        interaction_efield_triplets; // TODO reserve
-    std::unordered_map<int, std::vector<eigen_triplet_t>>
-        interaction_bfield_triplets; // TODO reserve
-    std::unordered_map<std::array<int, 2>, std::vector<eigen_triplet_t>,
-                       utils::hash<std::array<int, 2>>>
-        interaction_diamagnetism_triplets; // TODO reserve
-    std::unordered_map<int, std::vector<eigen_triplet_t>>
-        interaction_multipole_triplets; // TODO reserve
-    // Loop over column entries
-    for (const auto &c : states) { // TODO parallelization
-        if (c.state.isArtificial()) {
+    // Determine how much the quantum numbers l, j, m of coupled states can differ at most
+    int delta_l_max = 0;
+    int delta_j_max = 0;
+    std::vector<int> delta_m;
+    for (const auto &i : erange) {
+        delta_l_max = std::max(delta_l_max, 1);
+        delta_j_max = std::max(delta_j_max, 1);
+        delta_m.push_back(i);
+    }
+    for (const auto &i : brange) {
+        delta_j_max = std::max(delta_j_max, 1);
+        delta_m.push_back(i);
+    }
+    for (const auto &i : drange) {
+        delta_l_max = std::max(delta_l_max, i[0]);
+        delta_j_max = std::max(delta_j_max, i[0]);
+        delta_m.push_back(i[1]);
+    }
+    for (const auto &order : orange) {
+        delta_l_max = std::max(delta_l_max, static_cast<int>(order));
+        delta_j_max = std::max(delta_j_max, static_cast<int>(order));
+        delta_m.push_back(0);
+    }
+    std::sort(delta_m.begin(), delta_m.end());
+    delta_m.erase(std::unique(delta_m.begin(), delta_m.end()), delta_m.end());
+
+    // Sort the states into buckets of equal l, 2*j, 2*m so that for a given column, only the rows
+    // that can fulfill the selection rules have to be visited
+    auto bucket_key = [](const StateOne &state, int delta_l, int delta_j, int delta_m) {
+        return std::array<int, 3>{{state.getL() + delta_l,
+                                   static_cast<int>(std::lround(2 * state.getJ())) + 2 * delta_j,
+                                   static_cast<int>(std::lround(2 * state.getM())) + 2 * delta_m}};
+    };
+    std::unordered_map<std::array<int, 3>, std::vector<const enumerated_state<StateOne> *>,
+                       utils::hash<std::array<int, 3>>>
+        buckets;
+    std::vector<const enumerated_state<StateOne> *> columns;
+    columns.reserve(states.size());
+    for (const auto &entry : states) {
+        if (entry.state.isArtificial()) {
             continue;
         }
+        buckets[bucket_key(entry.state, 0, 0, 0)].push_back(&entry);
+        columns.push_back(&entry);
+    }
 
-        // Loop over row entries
-        for (const auto &r : states) {
-            if (r.state.isArtificial()) {
-                continue;
-            }
-
-            // E-field interaction
-            for (const auto &i : erange) {
-                if (i == 0 && r.idx < c.idx) {
-                    continue;
-                }
+    ////////////////////////////////////////////////////////////////////
+    /// Calculate the interaction in the canonical basis ///////////////
+    ////////////////////////////////////////////////////////////////////
 
-                if (selectionRulesMultipoleNew(r.state, c.state, 1, i)) {
-                    scalar_t value = cache.getElectricDipole(r.state, c.state);
-                    this->addTriplet(interaction_efield_triplets[i], r.idx, c.idx, value);
-                    break; // because for the other operators, the selection rule for the magnetic
-                           // quantum numbers will not be fulfilled
+    std::unordered_map<int, std::vector<eigen_triplet_t>> interaction_efield_triplets;
+    std::unordered_map<int, std::vector<eigen_triplet_t>> interaction_bfield_triplets;
+    std::unordered_map<std::array<int, 2>, std::vector<eigen_triplet_t>,
+                       utils::hash<std::array<int, 2>>>
+        interaction_diamagnetism_triplets;
+    std::unordered_map<int, std::vector<eigen_triplet_t>> interaction_multipole_triplets;
+
+#pragma omp parallel
+    {
+        // Thread-local triplets which are merged after the loop
+        std::unordered_map<int, std::vector<eigen_triplet_t>> efield_triplets;
+        std::unordered_map<int, std::vector<eigen_triplet_t>> bfield_triplets;
+        std::unordered_map<std::array<int, 2>, std::vector<eigen_triplet_t>,
+                           utils::hash<std::array<int, 2>>>
+            diamagnetism_triplets;
+        std::unordered_map<int, std::vector<eigen_triplet_t>> multipole_triplets;
+
+        std::vector<const enumerated_state<StateOne> *> rows;
+
+        // Loop over column entries
+#pragma omp for schedule(dynamic)
+        for (size_t idx_column = 0; idx_column < columns.size(); ++idx_column) {
+            const auto &c = *columns[idx_column];
+
+            // Collect the row entries that can couple to the column entry
+            rows.clear();
+            for (int delta_l = -delta_l_max; delta_l <= delta_l_max; ++delta_l) {
+                for (int delta_j = -delta_j_max; delta_j <= delta_j_max; ++delta_j) {
+                    for (const auto &dm : delta_m) {
+                        auto bucket = buckets.find(bucket_key(c.state, delta_l, delta_j, dm));
+                        if (bucket != buckets.end()) {
+                            rows.insert(rows.end(), bucket->second.begin(), bucket->second.end());
+                        }
+                    }
                 }
             }
 
-            // B-field interaction
-            for (const auto &i : brange) {
-                if (i == 0 && r.idx < c.idx) {
-                    continue;
-                }
+            // Loop over row entries
+            for (const auto *row : rows) {
+                const auto &r = *row;
+
+                // E-field interaction
+                for (const auto &i : erange) {
+                    if (i == 0 && r.idx < c.idx) {
+                        continue;
+                    }
 
-                if (selectionRulesMomentumNew(r.state, c.state, i)) {
-                    scalar_t value = cache.getMagneticDipole(r.state, c.state);
-                    this->addTriplet(interaction_bfield_triplets[i], r.idx, c.idx, value);
-                    break; // because for the other operators, the selection rule for the magnetic
-                           // quantum numbers will not be fulfilled
+                    if (selectionRulesMultipoleNew(r.state, c.state, 1, i)) {
+                        scalar_t value = cache.getElectricDipole(r.state, c.state);
+                        this->addTriplet(efield_triplets[i], r.idx, c.idx, value);
+                        break; // because for the other operators, the selection rule for the
+                               // magnetic quantum numbers will not be fulfilled
+                    }
                 }
-            }
 
-            // Diamagnetic interaction
-            for (const auto &i : drange) {
-                if (i[1] == 0 && r.idx < c.idx) {
-                    continue;
+                // B-field interaction
+                for (const auto &i : brange) {
+                    if (i == 0 && r.idx < c.idx) {
+                        continue;
+                    }
+
+                    if (selectionRulesMomentumNew(r.state, c.state, i)) {
+                        scalar_t value = cache.getMagneticDipole(r.state, c.state);
+                        this->addTriplet(bfield_triplets[i], r.idx, c.idx, value);
+                        break; // because for the other operators, the selection rule for the
+                               // magnetic quantum numbers will not be fulfilled
+                    }
                 }
 
-                if (selectionRulesMultipoleNew(r.state, c.state, i[0], i[1])) {
-                    scalar_t value = 1. / (8 * electron_rest_mass) *
-                        cache.getDiamagnetism(r.state, c.state, i[0]);
-                    this->addTriplet(interaction_diamagnetism_triplets[i], r.idx, c.idx, value);
+                // Diamagnetic interaction
+                for (const auto &i : drange) {
+                    if (i[1] == 0 && r.idx < c.idx) {
+                        continue;
+                    }
+
+                    if (selectionRulesMultipoleNew(r.state, c.state, i[0], i[1])) {
+                        scalar_t value = 1. / (8 * electron_rest_mass) *
+                            cache.getDiamagnetism(r.state, c.state, i[0]);
+                        this->addTriplet(diamagnetism_triplets[i], r.idx, c.idx, value);
+                    }
                 }
-            }
 
-            // Multipole interaction with an ion
-            if (charge != 0) {
-                int q = r.state.getM() - c.state.getM();
-                if (q == 0) { // total momentum consreved
-                    for (const auto &order : orange) {
-                        if (selectionRulesMultipoleNew(r.state, c.state, order)) {
-                            double val = -coulombs_constant * elementary_charge *
-                                cache.getElectricMultipole(r.state, c.state, order);
-                            this->addTriplet(interaction_multipole_triplets[order], r.idx, c.idx,
-                                             val);
+                // Multipole interaction with an ion
+                if (charge != 0) {
+                    int q = r.state.getM() - c.state.getM();
+                    if (q == 0) { // total momentum consreved
+                        for (const auto &order : orange) {
+                            if (selectionRulesMultipoleNew(r.state, c.state, order)) {
+                                double val = -coulombs_constant * elementary_charge *
+                                    cache.getElectricMultipole(r.state, c.state, order);
+                                this->addTriplet(multipole_triplets[order], r.idx, c.idx, val);
+                            }
                         }
                     }
                 }
             }
         }
+
+        // Merge the thread-local triplets
+#pragma omp critical(triplets)
+        {
+            for (auto &entry : efield_triplets) {
+                auto &triplets = interaction_efield_triplets[entry.first];
+                triplets.insert(triplets.end(), entry.second.begin(), entry.second.end());
+            }
+            for (auto &entry : bfield_triplets) {
+                auto &triplets = interaction_bfield_triplets[entry.first];
+                triplets.insert(triplets.end(), entry.second.begin(), entry.second.end());
+            }
+            for (auto &entry : diamagnetism_triplets) {
+                auto &triplets = interaction_diamagnetism_triplets[entry.first];
+                triplets.insert(triplets.end(), entry.second.begin(), entry.second.end());
+            }
+            for (auto &entry : multipole_triplets) {
+                auto &triplets = interaction_multipole_triplets[entry.first];
+                triplets.insert(triplets.end(), entry.second.begin(), entry.second.end());
+            }
+        }
     }
     ////////////////////////////////////////////////////////////////////
     /// Build and transform the interaction to the used basis //////////
@@ -22,10 +22,12 @@
 #include "dtypes.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <limits>
 #include <numeric>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -226,16 +228,8 @@ void SystemTwo::initializeBasis() {
     /// Combine one atom states ////////////////////////////////////////
 
     std::vector<eigen_triplet_t> hamiltonian_triplets;
-    hamiltonian_triplets.reserve(system1.getNumBasisvectors() * system2.getNumBasisvectors());
-    states.reserve(system1.getNumStates() * system2.getNumStates() + states_to_add.size());
     std::vector<eigen_triplet_t> basisvectors_triplets; // TODO reserve
-    std::vector<double> sqnorm_list(
-        system1.getNumStates() * system2.getNumStates() + states_to_add.size(), 0);
-
-    int M = 0;
-    int parityL = 0;
-    int parityJ = 0;
-    int parityM = 0;
+    std::vector<double> sqnorm_list;
 
     size_t col_new = 0;
 
@@ -244,31 +238,63 @@ void SystemTwo::initializeBasis() {
     if (!one_atom_basisvectors_indices.empty()) {
         pairs = one_atom_basisvectors_indices;
     } else {
-        pairs.reserve(system1.getNumBasisvectors() * system2.getNumBasisvectors());
+        // Sort the basis vectors of the second atom by energy so that for each basis vector of
+        // the first atom, the partners which lead to a valid pair state energy form a contiguous
+        // range (the sum of floating point numbers is monotonic in each summand, so the search
+        // gives the same result as checking each pair)
+        std::vector<std::pair<double, size_t>> energies2;
+        energies2.reserve(system2.getNumBasisvectors());
+        for (size_t col_2 = 0; col_2 < system2.getNumBasisvectors(); ++col_2) {
+            energies2.emplace_back(std::real(system2.getHamiltonian().coeff(col_2, col_2)), col_2);
+        }
+        std::sort(energies2.begin(), energies2.end());
+
+        std::vector<size_t> partners;
         for (size_t col_1 = 0; col_1 < system1.getNumBasisvectors(); ++col_1) {
-            for (size_t col_2 = 0; col_2 < system2.getNumBasisvectors(); ++col_2) {
+            double energy1 = std::real(system1.getHamiltonian().coeff(col_1, col_1));
+
+            auto first = energies2.begin();
+            if (energy_min != std::numeric_limits<double_t>::lowest()) {
+                first = std::partition_point(energies2.begin(), energies2.end(),
+                                             [&](const std::pair<double, size_t> &entry) {
+                                                 return !(energy1 + entry.first > energy_min);
+                                             });
+            }
+            auto last = energies2.end();
+            if (energy_max != std::numeric_limits<double_t>::max()) {
+                last = std::partition_point(first, energies2.end(),
+                                            [&](const std::pair<double, size_t> &entry) {
+                                                return energy1 + entry.first < energy_max;
+                                            });
+            }
+
+            // Keep the original order of the pairs
+            partners.clear();
+            for (auto it = first; it != last; ++it) {
+                partners.push_back(it->second);
+            }
+            std::sort(partners.begin(), partners.end());
+            for (const auto &col_2 : partners) {
                 pairs.push_back({col_1, col_2});
             }
         }
     }
 
-    // Loop over the pairs
+    // Select the pairs that form a basis vector
+    std::vector<std::array<size_t, 2>> pairs_selected;
+    pairs_selected.reserve(pairs.size());
     for (const auto &[col_1, col_2] : pairs) {
 
         // In case of artificial states, some symmetries won't work
         auto sym_inversion_local = sym_inversion;
-        auto sym_reflection_local = sym_reflection;
-        auto sym_rotation_local = sym_rotation;
         if (artificial1[col_1] || artificial2[col_2]) {
-            if (sym_inversion_local != NA || sym_reflection_local != NA ||
-                sym_rotation_local.count(ARB) == 0) {
+            if (sym_inversion_local != NA || sym_reflection != NA ||
+                sym_rotation.count(ARB) == 0) {
                 std::cerr
                     << "WARNING: Only permutation symmetry can be applied to artificial states."
                     << std::endl;
             }
             sym_inversion_local = NA;
-            sym_reflection_local = NA;
-            sym_rotation_local = std::set<int>({ARB});
         }
 
         // In case of inversion or permutation symmetry: skip half of the basis vector pairs
@@ -290,128 +316,169 @@ void SystemTwo::initializeBasis() {
 
         // Store the pair state energy
         hamiltonian_triplets.emplace_back(col_new, col_new, energy);
+        pairs_selected.push_back({col_1, col_2});
+        ++col_new;
+    }
+    pairs.clear();
+    pairs.shrink_to_fit();
+
+    // Build the basis vectors that correspond to the stored pair state energies. The entries of
+    // the basis vectors are calculated in parallel for chunks of pairs. Afterwards, they are
+    // added in the order of the pairs so that the enumeration of the two atom states does not
+    // depend on the number of threads.
+    const auto &basisvectors1 = system1.getBasisvectors();
+    const auto &basisvectors2 = system2.getBasisvectors();
+    const auto &states1 = system1.getStatesMultiIndex();
+    const auto &states2 = system2.getStatesMultiIndex();
+    const size_t chunk_size = 4096;
+    std::vector<std::vector<std::pair<StateTwo, scalar_t>>> entries_of_pairs(
+        std::min(chunk_size, pairs_selected.size()));
+
+    for (size_t idx_first = 0; idx_first < pairs_selected.size(); idx_first += chunk_size) {
+        size_t idx_last = std::min(idx_first + chunk_size, pairs_selected.size());
+
+#pragma omp parallel for schedule(dynamic)
+        for (size_t idx_pair = idx_first; idx_pair < idx_last; ++idx_pair) {
+            const auto &[col_1, col_2] = pairs_selected[idx_pair];
+            auto &entries = entries_of_pairs[idx_pair - idx_first];
+            entries.clear();
+
+            // In case of artificial states, some symmetries won't work
+            auto sym_inversion_local = sym_inversion;
+            auto sym_reflection_local = sym_reflection;
+            auto sym_rotation_local = sym_rotation;
+            if (artificial1[col_1] || artificial2[col_2]) {
+                sym_inversion_local = NA;
+                sym_reflection_local = NA;
+                sym_rotation_local = std::set<int>({ARB});
+            }
 
-        // Build the basis vector that corresponds to the stored pair state energy
-        for (eigen_iterator_t triple_1(system1.getBasisvectors(), col_1); triple_1; ++triple_1) {
-            size_t row_1 = triple_1.row();
-            StateOne state_1 = system1.getStatesMultiIndex()[row_1].state;
+            int M = 0;
+            int parityL = 0;
+            int parityJ = 0;
+            int parityM = 0;
 
-            for (eigen_iterator_t triple_2(system2.getBasisvectors(), col_2); triple_2;
-                 ++triple_2) {
-                size_t row_2 = triple_2.row();
-                StateOne state_2 = system2.getStatesMultiIndex()[row_2].state;
+            for (eigen_iterator_t triple_1(basisvectors1, col_1); triple_1; ++triple_1) {
+                const StateOne &state_1 = states1[triple_1.row()].state;
 
-                scalar_t value_new = triple_1.value() * triple_2.value();
+                for (eigen_iterator_t triple_2(basisvectors2, col_2); triple_2; ++triple_2) {
+                    const StateOne &state_2 = states2[triple_2.row()].state;
 
-                if (!artificial1[col_1] && !artificial2[col_2]) {
-                    M = state_1.getM() + state_2.getM();
-                    parityL = std::pow(-1, state_1.getL() + state_2.getL());
-                    parityJ = std::pow(-1, state_1.getJ() + state_2.getJ());
-                    parityM = std::pow(-1, M);
-                }
+                    scalar_t value_new = triple_1.value() * triple_2.value();
 
-                bool different = col_1 != col_2;
+                    if (!artificial1[col_1] && !artificial2[col_2]) {
+                        M = state_1.getM() + state_2.getM();
+                        parityL = std::pow(-1, state_1.getL() + state_2.getL());
+                        parityJ = std::pow(-1, state_1.getJ() + state_2.getJ());
+                        parityM = std::pow(-1, M);
+                    }
 
-                // Consider rotation symmetry
-                if (sym_rotation_local.count(ARB) == 0 && sym_rotation_local.count(M) == 0) {
-                    continue;
-                }
+                    bool different = col_1 != col_2;
 
-                // Combine symmetries
-                bool skip_reflection = false;
-                if (different) {
-                    // In case of inversion and permutation symmetry: the inversion symmetric
-                    // state is already permutation symmetric
-                    if (sym_inversion_local != NA && sym_permutation != NA) {
-                        if (((sym_inversion_local == EVEN) ? -parityL : parityL) !=
-                            ((sym_permutation == EVEN) ? -1 : 1)) {
-                            continue; // parity under inversion and permutation is different
-                        }
+                    // Consider rotation symmetry
+                    if (sym_rotation_local.count(ARB) == 0 && sym_rotation_local.count(M) == 0) {
+                        continue;
                     }
 
-                    // In case of inversion or permutation and reflection symmetry: the
-                    // inversion or permutation symmetric state is already reflection symmetric
-                    if (sym_inversion_local != NA && sym_reflection_local != NA &&
-                        StateTwo(state_1.getReflected(), state_2.getReflected()) ==
-                            StateTwo(state_2, state_1)) {
-                        if (((sym_inversion_local == EVEN) ? -parityL : parityL) !=
-                            ((sym_reflection_local == EVEN) ? parityL * parityJ * parityM
-                                                            : -parityL * parityJ * parityM)) {
-                            continue; // parity under inversion and reflection is different
+                    // Combine symmetries
+                    bool skip_reflection = false;
+                    if (different) {
+                        // In case of inversion and permutation symmetry: the inversion symmetric
+                        // state is already permutation symmetric
+                        if (sym_inversion_local != NA && sym_permutation != NA) {
+                            if (((sym_inversion_local == EVEN) ? -parityL : parityL) !=
+                                ((sym_permutation == EVEN) ? -1 : 1)) {
+                                continue; // parity under inversion and permutation is different
+                            }
                         }
-                        skip_reflection = true; // parity under inversion and reflection is the same
-
-                    } else if (sym_permutation != NA && sym_reflection_local != NA &&
-                               StateTwo(state_1.getReflected(), state_2.getReflected()) ==
-                                   StateTwo(state_2, state_1)) {
-                        if (((sym_permutation == EVEN) ? -1 : 1) !=
-                            ((sym_reflection_local == EVEN) ? parityL * parityJ * parityM
-                                                            : -parityL * parityJ * parityM)) {
-                            continue; // parity under permutation and reflection is different
+
+                        // In case of inversion or permutation and reflection symmetry: the
+                        // inversion or permutation symmetric state is already reflection
+                        // symmetric
+                        if (sym_inversion_local != NA && sym_reflection_local != NA &&
+                            StateTwo(state_1.getReflected(), state_2.getReflected()) ==
+                                StateTwo(state_2, state_1)) {
+                            if (((sym_inversion_local == EVEN) ? -parityL : parityL) !=
+                                ((sym_reflection_local == EVEN) ? parityL * parityJ * parityM
+                                                                : -parityL * parityJ * parityM)) {
+                                continue; // parity under inversion and reflection is different
+                            }
+                            skip_reflection =
+                                true; // parity under inversion and reflection is the same
+
+                        } else if (sym_permutation != NA && sym_reflection_local != NA &&
+                                   StateTwo(state_1.getReflected(), state_2.getReflected()) ==
+                                       StateTwo(state_2, state_1)) {
+                            if (((sym_permutation == EVEN) ? -1 : 1) !=
+                                ((sym_reflection_local == EVEN) ? parityL * parityJ * parityM
+                                                                : -parityL * parityJ * parityM)) {
+                                continue; // parity under permutation and reflection is different
+                            }
+                            skip_reflection =
+                                true; // parity under permutation and reflection is the same
                         }
-                        skip_reflection =
-                            true; // parity under permutation and reflection is the same
                     }
-                }
-
-                // Adapt the normalization if required by symmetries
-                if ((sym_inversion_local != NA || sym_permutation != NA) && different) {
-                    value_new /= std::sqrt(2);
-                }
-                if (sym_reflection_local != NA && !skip_reflection) {
-                    value_new /= std::sqrt(2) * std::sqrt(2);
-                    // the second factor std::sqrt(2) is because of double counting
-                }
 
-                // Add an entry to the current basis vector
-                this->addBasisvectors(StateTwo(state_1, state_2), col_new, value_new,
-                                      basisvectors_triplets, sqnorm_list);
-
-                // Add further entries to the current basis vector if required by symmetries
-                if (different) {
-                    if (sym_inversion_local != NA) {
-                        scalar_t v = value_new;
-                        v *= (sym_inversion_local == EVEN) ? -parityL : parityL;
-                        this->addBasisvectors(StateTwo(state_2, state_1), col_new, v,
-                                              basisvectors_triplets, sqnorm_list);
-                    } else if (sym_permutation != NA) {
-                        scalar_t v = value_new;
-                        v *= (sym_permutation == EVEN) ? -1 : 1;
-                        this->addBasisvectors(StateTwo(state_2, state_1), col_new, v,
-                                              basisvectors_triplets, sqnorm_list);
+                    // Adapt the normalization if required by symmetries
+                    if ((sym_inversion_local != NA || sym_permutation != NA) && different) {
+                        value_new /= std::sqrt(2);
+                    }
+                    if (sym_reflection_local != NA && !skip_reflection) {
+                        value_new /= std::sqrt(2) * std::sqrt(2);
+                        // the second factor std::sqrt(2) is because of double counting
                     }
-                }
-                if (sym_reflection_local != NA && !skip_reflection) {
-                    scalar_t v = value_new;
-                    v *= (sym_reflection_local == EVEN) ? parityL * parityJ * parityM
-                                                        : -parityL * parityJ * parityM;
-                    this->addBasisvectors(StateTwo(state_1.getReflected(), state_2.getReflected()),
-                                          col_new, v, basisvectors_triplets, sqnorm_list);
 
+                    // Add an entry to the current basis vector
+                    entries.emplace_back(StateTwo(state_1, state_2), value_new);
+
+                    // Add further entries to the current basis vector if required by symmetries
                     if (different) {
                         if (sym_inversion_local != NA) {
                             scalar_t v = value_new;
-                            v *= (sym_reflection_local == EVEN) ? parityL * parityJ * parityM
-                                                                : -parityL * parityJ * parityM;
                             v *= (sym_inversion_local == EVEN) ? -parityL : parityL;
-                            this->addBasisvectors(
-                                StateTwo(state_2.getReflected(), state_1.getReflected()), col_new,
-                                v, basisvectors_triplets, sqnorm_list);
+                            entries.emplace_back(StateTwo(state_2, state_1), v);
                         } else if (sym_permutation != NA) {
                             scalar_t v = value_new;
-                            v *= (sym_reflection_local == EVEN) ? parityL * parityJ * parityM
-                                                                : -parityL * parityJ * parityM;
                             v *= (sym_permutation == EVEN) ? -1 : 1;
-                            this->addBasisvectors(
-                                StateTwo(state_2.getReflected(), state_1.getReflected()), col_new,
-                                v, basisvectors_triplets, sqnorm_list);
+                            entries.emplace_back(StateTwo(state_2, state_1), v);
+                        }
+                    }
+                    if (sym_reflection_local != NA && !skip_reflection) {
+                        scalar_t v = value_new;
+                        v *= (sym_reflection_local == EVEN) ? parityL * parityJ * parityM
+                                                            : -parityL * parityJ * parityM;
+                        entries.emplace_back(
+                            StateTwo(state_1.getReflected(), state_2.getReflected()), v);
+
+                        if (different) {
+                            if (sym_inversion_local != NA) {
+                                scalar_t v = value_new;
+                                v *= (sym_reflection_local == EVEN)
+                                    ? parityL * parityJ * parityM
+                                    : -parityL * parityJ * parityM;
+                                v *= (sym_inversion_local == EVEN) ? -parityL : parityL;
+                                entries.emplace_back(
+                                    StateTwo(state_2.getReflected(), state_1.getReflected()), v);
+                            } else if (sym_permutation != NA) {
+                                scalar_t v = value_new;
+                                v *= (sym_reflection_local == EVEN)
+                                    ? parityL * parityJ * parityM
+                                    : -parityL * parityJ * parityM;
+                                v *= (sym_permutation == EVEN) ? -1 : 1;
+                                entries.emplace_back(
+                                    StateTwo(state_2.getReflected(), state_1.getReflected()), v);
+                            }
                         }
                     }
                 }
             }
         }
 
-        ++col_new;
+        for (size_t idx_pair = idx_first; idx_pair < idx_last; ++idx_pair) {
+            for (const auto &[state, value] : entries_of_pairs[idx_pair - idx_first]) {
+                this->addBasisvectors(state, idx_pair, value, basisvectors_triplets, sqnorm_list);
+            }
+        }
     }
 
     // Delete unecessary storage
@@ -440,6 +507,8 @@ void SystemTwo::initializeBasis() {
     }
 
     // Add user-defined states
+    int M = 0;
+    int parityL = 0;
     for (const auto &state : states_to_add) {
         bool different = state.getFirstState() != state.getSecondState();
 
@@ -801,20 +870,54 @@ void SystemTwo::initializeInteraction() {
         // TODO
     }*/
 
+    // Determine for each one-atom state the one-atom states that are coupled to it by one of the
+    // multipole operators. As the interaction is a sum of products of one-atom operators, a pair
+    // state can only couple to the products of these states. Thus, we do not have to loop over
+    // all pairs of two-atom states but only over the non-zero entries of the Kronecker products
+    // of the one-atom operators, restricted to the states of the basis.
+    std::array<std::unordered_map<StateOne, std::vector<StateOne>>, 2> coupled_states;
+    for (int atom = 0; atom < 2; ++atom) {
+        const auto &states_one = (atom == 0) ? states1 : states2;
+        for (const auto &state_col : states_one) {
+            if (state_col.isArtificial()) {
+                continue;
+            }
+            auto &coupled = coupled_states[atom][state_col];
+            for (const auto &state_row : states_one) {
+                if (state_row.isArtificial()) {
+                    continue;
+                }
+                for (int kappa = 0; kappa <= static_cast<int>(ordermax) - 2; ++kappa) {
+                    if (selectionRulesMultipoleNew(state_row, state_col, kappa)) {
+                        coupled.push_back(state_row);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
     // Loop over column entries
+    std::vector<const enumerated_state<StateTwo> *> rows;
     for (const auto &c : states) { // TODO parallelization
         if (c.state.isArtificial(0) || c.state.isArtificial(1)) {
             continue;
         }
 
-        // Loop over row entries
-        for (const auto &r : states) {
-            if (r.state.isArtificial(0) || r.state.isArtificial(1)) {
-                continue;
-            }
-            if (r.idx < c.idx) {
-                continue;
+        // Determine the row entries that might couple to the column entry
+        rows.clear();
+        for (const auto &state_first : coupled_states[0][c.state.getFirstState()]) {
+            for (const auto &state_second : coupled_states[1][c.state.getSecondState()]) {
+                auto state_iter = states.get<1>().find(StateTwo(state_first, state_second));
+                if (state_iter != states.get<1>().end() && state_iter->idx >= c.idx) {
+                    rows.push_back(&*state_iter);
+                }
             }
+        }
+
+        // Loop over row entries
+        for (const auto *row : rows) {
+            const auto &r = *row;
 
             int q1 = r.state.getM(0) - c.state.getM(0);
             int q2 = r.state.getM(1) - c.state.getM(1);
@@ -1526,6 +1629,9 @@ void SystemTwo::addBasisvectors(const StateTwo &state, const size_t &col_new,
     }
 
     basisvectors_triplets.emplace_back(row_new, col_new, value_new);
+    if (row_new >= sqnorm_list.size()) {
+        sqnorm_list.resize(row_new + 1, 0);
+    }
     sqnorm_list[row_new] += std::pow(std::abs(value_new), 2);
 }
 
@@ -20,12 +20,18 @@
 #include "Wavefunction.hpp"
 #include "QuantumDefect.hpp"
 
+#include <boost/math/quadrature/gauss.hpp>
+
+#include <algorithm>
 #include <cctype>
 #include <cmath>
 #ifdef WITH_GSL
 #include <gsl/gsl_sf_hyperg.h>
 #endif
+#include <numeric>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 #include <vector>
 
 // --- Numerov's method ---
@@ -56,7 +62,22 @@ double g(QuantumDefect const &qd, double x) {
 
 } // namespace model_potential
 
-Numerov::Numerov(QuantumDefect const &qd) : qd(qd) {
+Numerov::Numerov(QuantumDefect const &qd, int stride) : qd(qd), stride(stride) {
+    if (stride < 1) {
+        throw std::runtime_error("The integration step must be a positive multiple of dx.");
+    }
+
+    double const xmin = getInnerBound(qd);
+    int const nsteps = getNumberOfSteps(qd, stride);
+
+    xy = eigen_dense_double_t::Zero(nsteps, 2);
+
+    for (int i = 0; i < nsteps; ++i) {
+        xy(i, 0) = getGridPoint(xmin, stride, i);
+    }
+}
+
+double Numerov::getInnerBound(QuantumDefect const &qd) {
     // augmented classical turning point
     double xmin = qd.n * qd.n - qd.n * std::sqrt(qd.n * qd.n - (qd.l - 1) * (qd.l - 1));
     if (xmin < 2.08) {
@@ -64,47 +85,151 @@ Numerov::Numerov(QuantumDefect const &qd) : qd(qd) {
     } else {
         xmin = std::floor(std::sqrt(xmin));
     }
+    return xmin;
+}
 
-    double const xmax = std::sqrt(2 * qd.n * (qd.n + 15));
-    double const nsteps = std::ceil((xmax - xmin) / dx);
-
-    xy = eigen_dense_double_t::Zero(nsteps, 2);
+double Numerov::getOuterBound(QuantumDefect const &qd) {
+    return std::sqrt(2 * qd.n * (qd.n + 15));
+}
 
-    for (int i = 0; i < nsteps; ++i) {
-        xy(i, 0) = (xmin + i * dx);
+double Numerov::getGridPoint(double xmin, int stride, int i) {
+    if (stride == 1) {
+        return xmin + i * dx;
     }
+    // The coarse grids start at the largest multiple of the step below the inner bound
+    double const step = stride * dx;
+    return (std::floor(xmin / step) + i) * step;
+}
+
+int Numerov::getNumberOfSteps(QuantumDefect const &qd, int stride) {
+    return std::ceil((getOuterBound(qd) - getGridPoint(getInnerBound(qd), stride, 0)) /
+                     (stride * dx));
 }
 
 eigen_dense_double_t Numerov::integrate() {
-    using model_potential::g;
+    xy = integrate(std::vector<QuantumDefect const *>{&qd}, stride).front();
+    return xy;
+}
 
-    int const nsteps = xy.rows();
+std::vector<std::vector<size_t>>
+Numerov::makeBatches(std::vector<QuantumDefect const *> const &qds) {
+    // States can be integrated together if the grid and the model potential agree
+    auto potential = [&](size_t idx) {
+        auto const &qd = *qds[idx];
+        return std::make_tuple(qd.species, qd.l, qd.j, getInnerBound(qd), qd.ac, qd.Z, qd.a1,
+                               qd.a2, qd.a3, qd.a4, qd.rc);
+    };
+
+    // Sort the states so that states of similar size end up in the same batch
+    std::vector<size_t> order(qds.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return std::make_tuple(potential(a), qds[a]->n) < std::make_tuple(potential(b), qds[b]->n);
+    });
+
+    std::vector<std::vector<size_t>> batches;
+    for (size_t idx : order) {
+        if (batches.empty() || batches.back().size() == batch_size ||
+            potential(batches.back().front()) != potential(idx)) {
+            batches.emplace_back();
+        }
+        batches.back().push_back(idx);
+    }
+    return batches;
+}
 
-    // Set the initial condition
-    if ((qd.n - qd.l) % 2 == 0) {
-        xy(nsteps - 2, 1) = -1e-10;
-    } else {
-        xy(nsteps - 2, 1) = 1e-10;
+std::vector<eigen_dense_double_t>
+Numerov::integrate(std::vector<QuantumDefect const *> const &batch, int stride) {
+    using model_potential::V;
+
+    if (stride < 1) {
+        throw std::runtime_error("The integration step must be a positive multiple of dx.");
+    }
+    if (batch.empty()) {
+        return {};
+    }
+    if (makeBatches(batch).size() != 1) {
+        throw std::runtime_error("The states cannot be integrated in the same batch.");
     }
 
-    // Perform the integration using Numerov's scheme
-    for (int i = nsteps - 3; i >= 0; --i) {
-        double A = (2. + 5. / 6. * dx * dx * g(qd, xy(i + 1, 0) * xy(i + 1, 0))) * xy(i + 1, 1);
-        double B = (1. - 1. / 12. * dx * dx * g(qd, xy(i + 2, 0) * xy(i + 2, 0))) * xy(i + 2, 1);
-        double C = 1. - 1. / 12. * dx * dx * g(qd, xy(i, 0) * xy(i, 0));
-        xy(i, 1) = (A - B) / C;
+    QuantumDefect const &qd = *batch.front();
+    double const xmin = getInnerBound(qd);
+    double const step = stride * dx;
+    auto const size = static_cast<Eigen::Index>(batch.size());
+
+    // Order the states by decreasing number of steps. The integration of a state starts at its
+    // outer bound, so that the states whose integration has started are always the first ones.
+    std::vector<size_t> order(batch.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return getNumberOfSteps(*batch[a], stride) > getNumberOfSteps(*batch[b], stride);
+    });
+
+    std::vector<int> nsteps(size);
+    Eigen::ArrayXd energy(size);
+    for (Eigen::Index s = 0; s < size; ++s) {
+        nsteps[s] = getNumberOfSteps(*batch[order[s]], stride);
+        energy(s) = batch[order[s]]->energy / au2GHz;
     }
+    int const nsteps_max = nsteps.front();
 
-    // Normalization
-    double norm = 0;
-    for (int i = 0; i < nsteps; ++i) {
-        norm += xy(i, 1) * xy(i, 1) * xy(i, 0) * xy(i, 0) * dx;
+    // The columns contain the amplitudes of all states at a grid point
+    Eigen::ArrayXXd y = Eigen::ArrayXXd::Zero(size, nsteps_max);
+
+    // Set the initial conditions
+    for (Eigen::Index s = 0; s < size; ++s) {
+        if ((batch[order[s]]->n - batch[order[s]]->l) % 2 == 0) {
+            y(s, nsteps[s] - 2) = -1e-10;
+        } else {
+            y(s, nsteps[s] - 2) = 1e-10;
+        }
+    }
+
+    // The scaling coefficient g of all states at a grid point, the model potential is evaluated
+    // only once (written out like model_potential::g to give the same results)
+    double const centrifugal = (2. * qd.l + .5) * (2. * qd.l + 1.5);
+    auto g = [&](int i, Eigen::ArrayXd &g_i) {
+        double const x = getGridPoint(xmin, stride, i) * getGridPoint(xmin, stride, i);
+        g_i = centrifugal / x + 8 * x * (V(qd, x) - energy);
+    };
+
+    // Perform the integration using Numerov's scheme
+    double const c_a = 5. / 6. * step * step;
+    double const c_b = 1. / 12. * step * step;
+    Eigen::ArrayXd g0(size), g1(size), g2(size);
+    if (nsteps_max >= 3) {
+        g(nsteps_max - 2, g1);
+        g(nsteps_max - 1, g2);
+    }
+    Eigen::Index active = 0;
+    for (int i = nsteps_max - 3; i >= 0; --i) {
+        while (active < size && nsteps[active] - 3 >= i) {
+            ++active;
+        }
+        g(i, g0);
+        auto A = (2. + c_a * g1.head(active)) * y.col(i + 1).head(active);
+        auto B = (1. - c_b * g2.head(active)) * y.col(i + 2).head(active);
+        auto C = 1. - c_b * g0.head(active);
+        y.col(i).head(active) = (A - B) / C;
+        g2.swap(g1);
+        g1.swap(g0);
     }
-    norm = std::sqrt(2 * norm);
 
-    if (norm > 0.0) {
-        for (int i = 0; i < nsteps; ++i) {
-            xy(i, 1) /= norm;
+    // Normalization, the amplitudes beyond the outer bound of a state are zero
+    Eigen::ArrayXd norm = Eigen::ArrayXd::Zero(size);
+    for (int i = 0; i < nsteps_max; ++i) {
+        double const x = getGridPoint(xmin, stride, i);
+        norm += y.col(i).square() * x * x * step;
+    }
+    norm = (2 * norm).sqrt();
+
+    std::vector<eigen_dense_double_t> xy(batch.size());
+    for (Eigen::Index s = 0; s < size; ++s) {
+        auto &xy_s = xy[order[s]];
+        xy_s.resize(nsteps[s], 2);
+        for (int i = 0; i < nsteps[s]; ++i) {
+            xy_s(i, 0) = getGridPoint(xmin, stride, i);
+            xy_s(i, 1) = norm(s) > 0.0 ? y(s, i) / norm(s) : y(s, i);
         }
     }
 
@@ -171,3 +296,52 @@ eigen_dense_double_t Whittaker::integrate() {
 
     return xy;
 }
+
+// --- Semiclassical method ---
+
+namespace semiclassical {
+
+double AngerJ(double nu, double z) {
+    auto integrand = [&](double theta) { return std::cos(nu * theta - z * std::sin(theta)); };
+    return boost::math::quadrature::gauss<double, 30>::integrate(integrand, 0., M_PI) / M_PI;
+}
+
+bool IsValid(QuantumDefect const &qd1, int power, QuantumDefect const &qd2) {
+    if (power != 1 || std::abs(qd1.l - qd2.l) != 1) {
+        return false;
+    }
+    if (qd1.n - qd1.nstar > 0.05 || qd2.n - qd2.nstar > 0.05) {
+        return false;
+    }
+    double const n_c = 2 * qd1.nstar * qd2.nstar / (qd1.nstar + qd2.nstar);
+    return std::max(qd1.l, qd2.l) <= 0.2 * n_c && std::abs(qd2.nstar - qd1.nstar) <= 5;
+}
+
+double RadialDipoleElement(QuantumDefect const &qd1, QuantumDefect const &qd2) {
+    if (!IsValid(qd1, 1, qd2)) {
+        throw std::runtime_error("The semiclassical approximation is not valid for the radial "
+                                 "matrix element.");
+    }
+
+    double const n_c = 2 * qd1.nstar * qd2.nstar / (qd1.nstar + qd2.nstar);
+    double const l_max = std::max(qd1.l, qd2.l);
+    double const s = qd2.nstar - qd1.nstar;
+    double const gamma = -(qd2.l - qd1.l) * l_max / n_c;
+
+    // For s -> 0, the expression approaches the matrix element of hydrogen
+    double g0 = 1, g1 = 0, g2 = 0, g3 = 0;
+    if (std::abs(s) > 1e-8) {
+        double const J_minus = AngerJ(s - 1, -s);
+        double const J_plus = AngerJ(s + 1, -s);
+        g0 = (J_minus - J_plus) / (3 * s);
+        g1 = -(J_minus + J_plus) / (3 * s);
+        g2 = g0 - std::sin(M_PI * s) / (M_PI * s);
+        g3 = s / 2 * g0 + g1;
+    }
+
+    double const sign = (qd1.n - qd1.l + qd2.n - qd2.l) % 2 == 0 ? 1 : -1;
+    return sign * 1.5 * n_c * n_c * std::sqrt(1 - (l_max / n_c) * (l_max / n_c)) *
+        (g0 + gamma * (g1 + gamma * (g2 + gamma * g3)));
+}
+
+} // namespace semiclassical
@@ -23,8 +23,11 @@
 #include "QuantumDefect.hpp"
 #include "dtypes.hpp"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdio>
 #include <limits>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -91,8 +94,13 @@ double g(QuantumDefect const &qd, double x);
  */
 class Numerov {
     QuantumDefect const &qd;
+    int stride;
     eigen_dense_double_t xy;
 
+    static double getInnerBound(QuantumDefect const &qd);
+    static double getOuterBound(QuantumDefect const &qd);
+    static double getGridPoint(double xmin, int stride, int i);
+
 public:
     /** \brief Integration step size */
     static constexpr double const dx = 0.01;
@@ -103,9 +111,14 @@ public:
      * condition for the integrator. It determines the outer and inner
      * integration bounds by semiclassical and empirical arguments.
      *
-     * \param[in] qd    Quantum defect data (parameters for the potentials)
+     * By default, the integration step is dx. A larger step stride*dx
+     * gives a coarser grid. Its points are multiples of the step, so
+     * that the grids of all states with the same stride are aligned.
+     *
+     * \param[in] qd        Quantum defect data (parameters for the potentials)
+     * \param[in] stride    Integration step in units of dx
      */
-    Numerov(QuantumDefect const &qd);
+    Numerov(QuantumDefect const &qd, int stride = 1);
 
     /** \brief Perform the integration
      *
@@ -115,6 +128,41 @@ public:
      */
     eigen_dense_double_t integrate();
 
+    /** \brief Maximum number of states in a batch */
+    static constexpr size_t const batch_size = 8;
+
+    /** \brief Split states into batches that are integrated together
+     *
+     * States of the same species with the same l and j have the same
+     * model potential. If their integration also starts at the same inner
+     * bound, they share the grid, so that the potential has to be
+     * evaluated only once per grid point for all of them. Such states are
+     * grouped into batches of at most batch_size states.
+     *
+     * \param[in] qds   Quantum defect data of the states
+     * \returns indices of the states in \p qds for each batch
+     */
+    static std::vector<std::vector<size_t>>
+    makeBatches(std::vector<QuantumDefect const *> const &qds);
+
+    /** \brief Perform the integration for a batch of states
+     *
+     * The states are advanced together, each step updates the
+     * wavefunctions of all states of the batch with vector operations.
+     * The results are identical to the ones of integrate().
+     *
+     * \param[in] batch     Quantum defect data of states that share the
+     *                      grid and the model potential, see makeBatches
+     * \param[in] stride    Integration step in units of dx
+     * \returns vectors with wavefunction amplitude in the order of \p batch
+     * \throws std::runtime_error if the states cannot be integrated together
+     */
+    static std::vector<eigen_dense_double_t>
+    integrate(std::vector<QuantumDefect const *> const &batch, int stride = 1);
+
+    /** \brief Number of integration steps of a state */
+    static int getNumberOfSteps(QuantumDefect const &qd, int stride = 1);
+
     /** \brief Power kernel for matrix elements
      *
      * The power kernel accounts for the fact that in %Numerov's method the
@@ -215,6 +263,64 @@ public:
     constexpr static inline double power_kernel(int power) { return 2 * power + 1; }
 };
 
+// --- Semiclassical method ---
+
+namespace semiclassical {
+/** \brief Compute the Anger function
+ *
+ * \f[
+ *      \mathbf{J}_\nu(z) = \frac{1}{\pi} \int_0^\pi \cos(\nu\theta - z\sin\theta) d\theta
+ * \f]
+ *
+ * The integral is evaluated by Gauss-Legendre quadrature, which is accurate for
+ * the small orders that occur in the radial matrix elements.
+ *
+ * \param[in] nu    order
+ * \param[in] z     argument
+ * \returns J_nu(z)
+ */
+double AngerJ(double nu, double z);
+
+/** \brief Check whether the semiclassical approximation is valid
+ *
+ * The semiclassical approximation is used for dipole matrix elements
+ * between states whose quantum defects are smaller than 0.05, so that they
+ * do not penetrate the core, if \f$ l_{\max} \le 0.2 n_c \f$ and the
+ * effective principal quantum numbers differ by at most 5. Within these
+ * bounds, the results deviate from %Numerov's method by less than 0.5%. For
+ * states whose principal quantum numbers differ by at most one, they deviate
+ * by less than 0.15%, and by less than 1e-4 if \f$ l_{\max} \le 0.1 n_c \f$
+ * (measured for Rb with 30 <= n <= 120).
+ *
+ * \param[in] qd1   Quantum defect data for first atom
+ * \param[in] power Exponent kappa
+ * \param[in] qd2   Quantum defect data for second atom
+ * \returns whether RadialDipoleElement can be used
+ */
+bool IsValid(QuantumDefect const &qd1, int power, QuantumDefect const &qd2);
+
+/** \brief Compute radial dipole matrix elements semiclassically
+ *
+ * The radial dipole matrix element is given by the quasiclassical expression
+ * of Kaulakys, J. Phys. B 28, 4963 (1995),
+ * \f[
+ *      \langle \nu_1 l_1 | r | \nu_2 l_2 \rangle = \frac{3}{2} n_c^2
+ *      \sqrt{1 - \left(\frac{l_{\max}}{n_c}\right)^2}
+ *      \sum_{p=0}^{3} \gamma^p g_p(s)
+ * \f]
+ * with \f$ n_c = 2\nu_1\nu_2/(\nu_1+\nu_2) \f$, \f$ s = \nu_2 - \nu_1 \f$,
+ * \f$ \gamma = -(l_2-l_1) l_{\max}/n_c \f$, and functions \f$ g_p \f$ that
+ * are given by Anger functions of the order \f$ s \pm 1 \f$. The sign
+ * follows the convention of %Numerov's method.
+ *
+ * \param[in] qd1   Quantum defect data for first atom
+ * \param[in] qd2   Quantum defect data for second atom
+ * \returns Radial matrix element in atomic units
+ * \throws std::runtime_error if the approximation is not valid, see IsValid
+ */
+double RadialDipoleElement(QuantumDefect const &qd1, QuantumDefect const &qd2);
+} // namespace semiclassical
+
 // --- Matrix element calculation ---
 
 /** \brief Find and return index
@@ -261,51 +367,105 @@ int findidx(T const &x, typename T::Scalar const &d,
     }
 }
 
-/** \brief Compute radial matrix elements
+/** \brief Compute radial matrix elements for several powers
  *
- * The radial matrix element can be calculated from the integral
- * \f[
- *      \langle nlj| \hat{p}^{\mathrm{rad}}_\kappa |n'l'j' \rangle =
- *      \int \Psi^{\text{rad}}_{nlj}(r) \Psi^{\text{rad}}_{n'l'j'}(r)
- * r^{2+\kappa} \; dr \f] The part \f$ r^{2+\kappa} \f$ varies with rescaling
- * the domain and is this given by the power_kernel function.
+ * The radial matrix elements for all exponents in \p powers are
+ * calculated in a single sweep over the overlapping part of the
+ * grids. Instead of evaluating the power kernel with std::pow at each
+ * grid point, the integrand is multiplied by the radial position as
+ * often as required to go from one exponent to the next.
  *
- * \tparam T        Method for calculating the wavefunction
- * \param[in] qd1   Quantum  defect data for first atom
- * \param[in] power Exponent kappa
- * \param[in] qd2   Quantum  defect data for second atom
- * \returns Radial matrix element
+ * \tparam T         Method for calculating the wavefunction
+ * \param[in] xy1    Wavefunction of the first atom as returned by T::integrate()
+ * \param[in] powers Exponents kappa in ascending order
+ * \param[in] xy2    Wavefunction of the second atom as returned by T::integrate()
+ * \param[in] stride Integration step of the wavefunctions in units of T::dx
+ * \returns Radial matrix elements in the order of \p powers
+ * \throws std::runtime_error if the exponents are not in ascending order
  */
 template <typename T>
-double IntegrateRadialElement(QuantumDefect const &qd1, int power, QuantumDefect const &qd2) {
-    T N1(qd1);
-    T N2(qd2);
+std::vector<double> IntegrateRadialElements(eigen_dense_double_t const &xy1,
+                                            std::vector<int> const &powers,
+                                            eigen_dense_double_t const &xy2, int stride = 1) {
+    if (!std::is_sorted(powers.begin(), powers.end())) {
+        throw std::runtime_error("The exponents must be in ascending order.");
+    }
 
-    auto const &xy1 = N1.integrate();
-    auto const &xy2 = N2.integrate();
-    auto const dx = T::dx;
+    auto const dx = stride * T::dx;
 
     auto const xmin = xy1(0, 0) >= xy2(0, 0) ? xy1(0, 0) : xy2(0, 0);
     auto const xmax = xy1(xy1.rows() - 1, 0) <= xy2(xy2.rows() - 1, 0) ? xy1(xy1.rows() - 1, 0)
                                                                        : xy2(xy2.rows() - 1, 0);
 
-    double mu = 0;
-    // If there is an overlap, calculate the matrix element
+    std::vector<double> mu(powers.size(), 0);
+    // If there is an overlap, calculate the matrix elements
     if (xmin <= xmax) {
         int start1 = findidx(xy1.col(0), xmin);
         int end1 = findidx(xy1.col(0), xmax);
         int start2 = findidx(xy2.col(0), xmin);
         int end2 = findidx(xy2.col(0), xmax);
+        int length = std::min(end1 - start1, end2 - start2);
 
-        int i1, i2;
-        for (i1 = start1, i2 = start2; i1 < end1 && i2 < end2; ++i1, ++i2) {
-            mu += xy1(i1, 1) * xy2(i2, 1) * std::pow(xy1(i1, 0), T::power_kernel(power)) * dx;
+        if (length > 0) {
+            auto const x = xy1.col(0).segment(start1, length).array();
+            Eigen::ArrayXd integrand = xy1.col(1).segment(start1, length).array() *
+                xy2.col(1).segment(start2, length).array() * dx;
+
+            int kernel = 0;
+            for (size_t idx = 0; idx < powers.size(); ++idx) {
+                for (; kernel < static_cast<int>(T::power_kernel(powers[idx])); ++kernel) {
+                    integrand *= x;
+                }
+                mu[idx] = 2 * integrand.sum();
+            }
         }
-        mu = 2 * mu;
     }
 
-    // The radial matrix element is returned in atomic units
+    // The radial matrix elements are returned in atomic units
     return mu;
 }
 
+/** \brief Compute radial matrix elements
+ *
+ * The radial matrix element can be calculated from the integral
+ * \f[
+ *      \langle nlj| \hat{p}^{\mathrm{rad}}_\kappa |n'l'j' \rangle =
+ *      \int \Psi^{\text{rad}}_{nlj}(r) \Psi^{\text{rad}}_{n'l'j'}(r)
+ * r^{2+\kappa} \; dr \f] The part \f$ r^{2+\kappa} \f$ varies with rescaling
+ * the domain and is this given by the power_kernel function.
+ *
+ * This overload takes wavefunctions that have already been
+ * integrated so that they can be reused for several matrix elements.
+ *
+ * \tparam T        Method for calculating the wavefunction
+ * \param[in] xy1   Wavefunction of the first atom as returned by T::integrate()
+ * \param[in] power Exponent kappa
+ * \param[in] xy2   Wavefunction of the second atom as returned by T::integrate()
+ * \returns Radial matrix element
+ */
+template <typename T>
+double IntegrateRadialElement(eigen_dense_double_t const &xy1, int power,
+                              eigen_dense_double_t const &xy2) {
+    return IntegrateRadialElements<T>(xy1, {power}, xy2)[0];
+}
+
+/** \brief Compute radial matrix elements
+ *
+ * Integrates the wavefunctions of both atoms and computes the radial
+ * matrix element from them.
+ *
+ * \tparam T        Method for calculating the wavefunction
+ * \param[in] qd1   Quantum  defect data for first atom
+ * \param[in] power Exponent kappa
+ * \param[in] qd2   Quantum  defect data for second atom
+ * \returns Radial matrix element
+ */
+template <typename T>
+double IntegrateRadialElement(QuantumDefect const &qd1, int power, QuantumDefect const &qd2) {
+    T N1(qd1);
+    T N2(qd2);
+
+    return IntegrateRadialElement<T>(N1.integrate(), power, N2.integrate());
+}
+
 #endif // WAVEFUNCTION_H
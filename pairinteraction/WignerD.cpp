@@ -19,14 +19,19 @@
 
 #include "WignerD.hpp"
 
+#include <stdexcept>
+
 WignerD::WignerD() = default;
 
 double WignerD::operator()(float j, float m, float mp, double beta) {
-    double tolerance = 1e-16;
-    if (std::abs(beta - M_PI / 2) < tolerance) {
-        return this->evalWignerdPiHalf(j, m, mp);
+    int twoj = std::lround(2 * j);
+    int i = std::lround(j - m);
+    int k = std::lround(j - mp);
+    if (i < 0 || i > twoj || k < 0 || k > twoj) {
+        throw std::runtime_error("The magnetic quantum numbers of the Wigner d-matrix element "
+                                 "exceed the angular momentum.");
     }
-    return this->evalWignerd(j, m, mp, beta);
+    return this->getMatrix(twoj, beta)[i * (twoj + 1) + k];
 }
 
 std::complex<double> WignerD::operator()(float j, float m, float mp, double alpha, double beta,
@@ -36,26 +41,38 @@ std::complex<double> WignerD::operator()(float j, float m, float mp, double alph
         std::complex<double>(std::cos(-mp * gamma), std::sin(-mp * gamma));
 }
 
-double WignerD::evalWignerdPiHalf(float j, float m, float mp) {
-    double r = 0;
-    for (unsigned int k = std::max(0, static_cast<int>(mp - m)); k <= j + std::min(mp, -m); ++k) {
-        r += std::pow(-1, k) * boost::math::binomial_coefficient<double>(j + mp, k) *
-            boost::math::binomial_coefficient<double>(j - mp, k + m - mp);
+const std::vector<double> &WignerD::getMatrix(int twoj, double beta) {
+    auto &matrices_beta = matrices[beta];
+    if (matrices_beta.empty()) {
+        matrices_beta.push_back({1});
     }
-    r *= std::pow(-1., m - mp) / std::pow(2., j) *
-        std::sqrt(
-             boost::math::factorial<double>(j + m) * boost::math::factorial<double>(j - m) /
-             (boost::math::factorial<double>(j + mp) * boost::math::factorial<double>(j - mp)));
-    return r;
-}
 
-double WignerD::evalWignerd(float j, float m, float mp, double beta) {
-    std::complex<double> r = 0;
-    for (float mpp = j; mpp >= -j; --mpp) { // TODO parallelize
-        r += this->evalWignerdPiHalf(j, m, mpp) *
-            std::complex<double>(std::cos(-mpp * beta), std::sin(-mpp * beta)) *
-            this->evalWignerdPiHalf(j, mpp, -mp);
+    // Couple a spin 1/2 to the matrix of j-1/2, using the Clebsch-Gordan coefficients
+    // <j-1/2, m-s; 1/2, s|j, m> = sqrt((j+2sm)/(2j)) and d^{1/2}(beta) = ((p, -q), (q, p))
+    double p = std::cos(beta / 2);
+    double q = std::sin(beta / 2);
+    for (int n = matrices_beta.size(); n <= twoj; ++n) {
+        const auto &previous = matrices_beta.back();
+        std::vector<double> matrix((n + 1) * (n + 1));
+        for (int i = 0; i <= n; ++i) {
+            for (int k = 0; k <= n; ++k) {
+                double value = 0;
+                if (i < n && k < n) {
+                    value += std::sqrt((n - i) * (n - k)) * p * previous[i * n + k];
+                }
+                if (i < n && k > 0) {
+                    value -= std::sqrt((n - i) * k) * q * previous[i * n + k - 1];
+                }
+                if (i > 0 && k < n) {
+                    value += std::sqrt(i * (n - k)) * q * previous[(i - 1) * n + k];
+                }
+                if (i > 0 && k > 0) {
+                    value += std::sqrt(i * k) * p * previous[(i - 1) * n + k - 1];
+                }
+                matrix[i * (n + 1) + k] = value / n;
+            }
+        }
+        matrices_beta.push_back(std::move(matrix));
     }
-    r *= std::pow(std::complex<double>(0, 1), 2. * j - m - mp) * std::pow(-1., 2. * m);
-    return r.real();
+    return matrices_beta[twoj];
 }
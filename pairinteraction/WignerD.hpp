@@ -22,23 +22,46 @@
 
 #define _USE_MATH_DEFINES
 
-#include <boost/math/special_functions/binomial.hpp>
-#include <boost/math/special_functions/factorials.hpp>
 #include <cmath>
 #include <complex>
-#include <numeric>
+#include <map>
 #include <vector>
 
+/** \brief Wigner D-matrix elements
+ *
+ * The Wigner d-matrices are calculated by Risbo's recursion, which builds the
+ * matrix for the angular momentum j from the matrix for j-1/2 by coupling a
+ * spin 1/2. Each step projects the product with the orthogonal matrix for
+ * j = 1/2 by Clebsch-Gordan coefficients, so that rounding errors do not grow
+ * and the recursion is numerically stable. For each angle beta, the matrices
+ * of all angular momenta up to the largest requested one are kept, so that
+ * rotating many states with the same object computes every matrix only once.
+ *
+ * The object is not thread-safe.
+ */
 class WignerD {
 public:
     WignerD();
+
+    /** \brief Element of the Wigner d-matrix
+     *
+     * \returns d^j_{m,mp}(beta)
+     * \throws std::runtime_error if m or mp is not a projection of j
+     */
     double operator()(float j, float m, float mp, double beta);
+
+    /** \brief Element of the Wigner D-matrix for the Euler angles alpha, beta, gamma (zyz)
+     *
+     * \returns exp(-i m alpha) d^j_{m,mp}(beta) exp(-i mp gamma)
+     */
     std::complex<double> operator()(float j, float m, float mp, double alpha, double beta,
                                     double gamma);
 
 private:
-    double evalWignerdPiHalf(float j, float m, float mp);
-    double evalWignerd(float j, float m, float mp, double beta);
+    /** \brief Wigner d-matrix, indexed by (j-m)*(2j+1) + (j-mp) */
+    const std::vector<double> &getMatrix(int twoj, double beta);
+
+    std::map<double, std::vector<std::vector<double>>> matrices; // beta -> 2j -> d-matrix
 };
 
 #endif
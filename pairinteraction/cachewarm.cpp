@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MatrixElementCache.hpp"
+#include "filesystem.hpp"
+#include "version.hpp"
+
+#include <array>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static void print_usage(std::ostream &os, int status) {
+    os << "Usage:\n"
+          "  -? [ --help ]         produce this help message\n"
+          "  -c [ --cache ] arg    Path to cache directory\n"
+          "  -s [ --species ] arg  Species, e.g. Rb\n"
+          "  -n [ --n ] arg1 arg2  Smallest and largest principal quantum number\n"
+          "  -l [ --lmax ] arg     Largest orbital angular momentum quantum number\n"
+          "  -k [ --kappa ] arg    Comma-separated orders of the radial matrix elements\n"
+          "                        (default: 0,1,2,3)\n"
+          "  -m [ --method ] arg   Method for calculating the radial matrix elements,\n"
+          "                        numerov, whittaker, or semiclassical (default: numerov)\n"
+          "  -e [ --export ]       Export the cache to the matrix element store in the cache\n"
+          "                        directory afterwards\n";
+    std::exit(status);
+}
+
+static int parse_int(std::string const &opt, std::string const &arg) {
+    try {
+        size_t pos = 0;
+        int value = std::stoi(arg, &pos);
+        if (pos == arg.size()) {
+            return value;
+        }
+    } catch (std::exception & /*e*/) {
+    }
+    std::cerr << "Option " << opt << " requires an integer argument\n";
+    std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 1) {
+        print_usage(std::cout, EXIT_SUCCESS);
+    }
+
+    std::string cachedir, species;
+    std::array<int, 2> n_range{{-1, -1}};
+    int l_max = -1;
+    std::vector<int> kappas{0, 1, 2, 3};
+    method_t method = NUMEROV;
+    bool export_store = false;
+
+    int optind = 1;
+    auto next_argument = [&](std::string const &opt) -> std::string {
+        ++optind;
+        if (!(optind < argc)) {
+            std::cerr << "Option " << opt << " requires an argument\n";
+            std::exit(EXIT_FAILURE);
+        }
+        return argv[optind];
+    };
+
+    while (optind < argc) {
+        std::string opt = argv[optind];
+        if (opt == "-?" || opt == "--help") {
+            print_usage(std::cout, EXIT_SUCCESS);
+        } else if (opt == "-c" || opt == "--cache") {
+            cachedir = next_argument(opt);
+        } else if (opt == "-s" || opt == "--species") {
+            species = next_argument(opt);
+        } else if (opt == "-n" || opt == "--n") {
+            n_range[0] = parse_int(opt, next_argument(opt));
+            n_range[1] = parse_int(opt, next_argument(opt));
+        } else if (opt == "-l" || opt == "--lmax") {
+            l_max = parse_int(opt, next_argument(opt));
+        } else if (opt == "-k" || opt == "--kappa") {
+            kappas.clear();
+            std::stringstream ss(next_argument(opt));
+            std::string kappa;
+            while (std::getline(ss, kappa, ',')) {
+                kappas.push_back(parse_int(opt, kappa));
+            }
+        } else if (opt == "-m" || opt == "--method") {
+            std::string name = next_argument(opt);
+            if (name == "numerov") {
+                method = NUMEROV;
+            } else if (name == "whittaker") {
+                method = WHITTAKER;
+            } else if (name == "semiclassical") {
+                method = SEMICLASSICAL;
+            } else {
+                std::cerr << "Unknown method: " << name << "\n";
+                std::exit(EXIT_FAILURE);
+            }
+        } else if (opt == "-e" || opt == "--export") {
+            export_store = true;
+        } else {
+            std::cerr << "Unknown option: " << opt << "\n";
+            print_usage(std::cerr, EXIT_FAILURE);
+        }
+        ++optind;
+    }
+
+    if (cachedir.empty() || species.empty() || n_range[0] < 0 || l_max < 0) {
+        std::cerr << "Options --cache, --species, --n, and --lmax are required\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    try {
+        MatrixElementCache cache(cachedir);
+        size_t num_missing = cache.warm(species, n_range, l_max, kappas, method);
+        std::cout << "Radial matrix elements loaded or calculated: " << num_missing << "\n";
+
+        if (export_store) {
+            cache.exportStore(
+                (fs::path(cachedir) / ("cache_elements_" + version::cache() + ".bin")).string());
+        }
+    } catch (std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
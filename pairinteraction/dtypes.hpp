@@ -102,6 +102,7 @@ enum parity_t {
 enum method_t {
     NUMEROV = 0,
     WHITTAKER = 1,
+    SEMICLASSICAL = 2,
 };
 
 struct Symmetry {
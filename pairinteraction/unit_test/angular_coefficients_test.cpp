@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AngularCoefficients.hpp"
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <wignerSymbols/wignerSymbols-cpp.h>
+
+#include <cmath>
+
+TEST_CASE("angular_coefficients") // NOLINT
+{
+    AngularCoefficients angular;
+
+    // Compare with the Wigner symbols for both orderings of the quantum numbers
+    for (int kappa = 0; kappa <= 3; ++kappa) {
+        for (float j1 = 0.5; j1 <= 5.5; ++j1) {
+            for (float j2 = 0.5; j2 <= 5.5; ++j2) {
+                for (float m1 = -j1; m1 <= j1; ++m1) {
+                    for (float m2 = -j2; m2 <= j2; ++m2) {
+                        double reference = std::pow(-1, int(j1 - m1)) *
+                            WignerSymbols::wigner3j(j1, kappa, j2, -m1, m1 - m2, m2);
+                        CHECK(angular.getAngular(kappa, j1, j2, m1, m2) ==
+                              doctest::Approx(reference).epsilon(1e-12));
+                    }
+                }
+            }
+        }
+    }
+
+    for (int kappa = 0; kappa <= 3; ++kappa) {
+        for (int l1 = 0; l1 <= 6; ++l1) {
+            for (int l2 = 0; l2 <= 6; ++l2) {
+                double reference = std::pow(-1, l1) * std::sqrt((2 * l1 + 1) * (2 * l2 + 1)) *
+                    WignerSymbols::wigner3j(l1, kappa, l2, 0, 0, 0);
+                CHECK(angular.getReducedMultipole(kappa, l1, l2) ==
+                      doctest::Approx(reference).epsilon(1e-12));
+            }
+        }
+    }
+
+    // Known values
+    CHECK(angular.getReducedMultipole(1, 0, 1) == doctest::Approx(-1));
+    CHECK(angular.getReducedCommutesS(0.5, 1, 0, 1, 0.5, 0.5) ==
+          doctest::Approx(std::sqrt(2. / 3.)));
+    CHECK(angular.getReducedCommutesL(0.5, 1, 0, 0, 0.5, 0.5) == doctest::Approx(1));
+
+    // Vanishing coefficients
+    CHECK(angular.getAngular(1, 0.5, 2.5, 0.5, 0.5) == 0);
+    CHECK(angular.getReducedMultipole(1, 0, 2) == 0);
+    CHECK(angular.getReducedCommutesS(0.5, 1, 0, 1, 1.5, 0.5) == 0);
+    CHECK(angular.getReducedCommutesS(0.5, 1, 0, 3, 0.5, 2.5) == 0);
+}
@@ -18,10 +18,13 @@
  */
 
 #include "Cache.hpp"
+#include "CacheStatistics.hpp"
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
+#include <chrono>
 #include <optional>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -65,3 +68,231 @@ TEST_CASE("parallel_cache_test") // NOLINT
         CHECK(cache.restore(i).value() == "Hello from thread " + std::to_string(i));
     }
 }
+
+TEST_CASE("lru_cache_test") // NOLINT
+{
+    LRUCache<int, std::string> cache(2);
+
+    CHECK_NOTHROW(cache.save(1, "one"));
+    CHECK_NOTHROW(cache.save(2, "two"));
+    CHECK_NOTHROW(cache.save(2, "zwei"));
+    CHECK(cache.restore(2).value() == "two");
+
+    // Restoring marks an element as recently used, so the element with key 2 is evicted
+    CHECK(cache.restore(1).value() == "one");
+    CHECK_NOTHROW(cache.save(3, "three"));
+    CHECK(cache.restore(1).value() == "one");
+    CHECK(!cache.restore(2).has_value());
+    CHECK(cache.restore(3).value() == "three");
+
+    CHECK_NOTHROW(cache.clear());
+    CHECK(!cache.restore(1).has_value());
+}
+
+TEST_CASE("lru_cache_size_test") // NOLINT
+{
+    LRUCache<int, std::string> cache(10, [](std::string const &s) { return s.size(); });
+
+    cache.save(1, "aaaa");
+    cache.save(2, "bbbb");
+    cache.save(3, "cccc");
+    CHECK(!cache.restore(1).has_value());
+    CHECK(cache.restore(2).has_value());
+    CHECK(cache.restore(3).has_value());
+
+    // An element larger than the capacity is still stored
+    cache.save(4, "dddddddddddd");
+    CHECK(cache.restore(4).has_value());
+    CHECK(!cache.restore(3).has_value());
+    CHECK(cache.get_size() == 12);
+    CHECK(cache.count() == 1);
+
+    // Shrinking the capacity evicts elements, even the most recently used one
+    cache.set_capacity(20);
+    cache.save(5, "eeee");
+    CHECK(cache.get_size() == 16);
+    cache.set_capacity(4);
+    CHECK(cache.get_size() == 4);
+    CHECK(cache.restore(5).has_value());
+    cache.set_capacity(0);
+    CHECK(cache.count() == 0);
+}
+
+TEST_CASE("flat_hash_map_test") // NOLINT
+{
+    // A constant hash lets all keys collide
+    struct CollidingHash {
+        std::size_t operator()(int /*key*/) const { return 7; }
+    };
+    FlatHashMap<int, std::string, CollidingHash> colliding;
+    FlatHashMap<int, std::string> map;
+
+    CHECK(map.find(1) == nullptr);
+    for (int key = 0; key < 100; ++key) {
+        map.insert_or_assign(key, std::to_string(key));
+        colliding.insert_or_assign(key, std::to_string(key));
+    }
+    map.insert_or_assign(42, "forty-two");
+    colliding.insert_or_assign(42, "forty-two");
+
+    CHECK(map.size() == 100);
+    CHECK(colliding.size() == 100);
+    for (int key = 0; key < 100; ++key) {
+        std::string expected = key == 42 ? "forty-two" : std::to_string(key);
+        CHECK(*map.find(key) == expected);
+        CHECK(*colliding.find(key) == expected);
+    }
+    CHECK(map.find(100) == nullptr);
+    CHECK(colliding.find(100) == nullptr);
+
+    int count = 0;
+    map.for_each([&count](int /*key*/, std::string const & /*e*/) { ++count; });
+    CHECK(count == 100);
+
+    CHECK_NOTHROW(map.clear());
+    CHECK(map.size() == 0);
+    CHECK(map.find(42) == nullptr);
+}
+
+TEST_CASE("flat_hash_map_evict_test") // NOLINT
+{
+    struct CollidingHash {
+        std::size_t operator()(int key) const { return key / 4; }
+    };
+    FlatHashMap<int, int, CollidingHash> map;
+    for (int key = 0; key < 8; ++key) {
+        map.insert_or_assign(key, key);
+    }
+
+    // All elements are referenced, a full sweep clears the flags
+    for (int key = 0; key < 8; ++key) {
+        CHECK(map.evict());
+        CHECK(map.size() == 7 - static_cast<std::size_t>(key));
+
+        // The remaining elements can still be found after the clusters have been shifted
+        int found = 0;
+        for (int k = 0; k < 8; ++k) {
+            if (auto const *e = map.find(k)) {
+                CHECK(*e == k);
+                ++found;
+            }
+        }
+        CHECK(found == 7 - key);
+    }
+    CHECK(!map.evict());
+
+    // Elements that have been referenced since the last sweep are kept
+    for (int key = 0; key < 4; ++key) {
+        map.insert_or_assign(key, key);
+    }
+    CHECK(map.evict());
+    std::vector<int> remaining;
+    map.for_each([&remaining](int key, int /*e*/) { remaining.push_back(key); });
+    REQUIRE(remaining.size() == 3);
+    map.find(remaining[0]);
+    map.find(remaining[2]);
+    CHECK(map.evict());
+    CHECK(map.size() == 2);
+    CHECK(map.find(remaining[0]) != nullptr);
+    CHECK(map.find(remaining[1]) == nullptr);
+    CHECK(map.find(remaining[2]) != nullptr);
+}
+
+TEST_CASE("sharded_cache_test") // NOLINT
+{
+    ShardedCache<int, std::string> cache;
+
+    std::vector<std::thread> threads(10);
+
+    for (std::size_t i = 0; i < 10; ++i) {
+        threads[i] = std::thread([&cache, i]() {
+            for (int key = 0; key < 1000; ++key) {
+                if (!cache.restore(key).has_value()) {
+                    cache.save(key, std::to_string(key));
+                }
+            }
+        });
+    }
+
+    for (std::size_t i = 0; i < 10; ++i) {
+        threads[i].join();
+    }
+
+    CHECK(cache.size() == 1000);
+    CHECK(cache.copy().size() == 1000);
+    CHECK(cache.restore(42).value() == "42");
+
+    // Saving overwrites existing elements
+    CHECK_NOTHROW(cache.save(42, "forty-two"));
+    CHECK(cache.restore(42).value() == "forty-two");
+
+    CHECK_NOTHROW(cache.clear());
+    CHECK(cache.size() == 0);
+    CHECK(!cache.restore(42).has_value());
+}
+
+TEST_CASE("sharded_cache_capacity_test") // NOLINT
+{
+    ShardedCache<int, int> cache;
+    for (int key = 0; key < 1000; ++key) {
+        cache.save(key, key);
+    }
+    std::size_t memory = cache.memory();
+
+    // Shrinking the capacity evicts elements
+    cache.set_capacity(160);
+    CHECK(cache.get_capacity() == 160);
+    CHECK(cache.size() <= 160);
+
+    // The size stays bounded, the remaining elements are correct
+    for (int key = 1000; key < 2000; ++key) {
+        cache.save(key, key);
+    }
+    CHECK(cache.size() <= 160);
+    CHECK(cache.restore(1999).value() == 1999);
+    for (int key = 0; key < 2000; ++key) {
+        if (auto e = cache.restore(key)) {
+            CHECK(e.value() == key);
+        }
+    }
+
+    cache.clear();
+    for (int key = 0; key < 1000; ++key) {
+        cache.save(key, key);
+    }
+    CHECK(cache.memory() < memory);
+}
+
+TEST_CASE("cache_statistics_test") // NOLINT
+{
+    CacheTableCounters counters;
+
+    // Count from several threads concurrently
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&counters]() {
+            for (int i = 0; i < 1000; ++i) {
+                CacheTableCounters::add(counters.local().hits);
+            }
+            CacheTableCounters::add(counters.local().misses, 10);
+            CacheTableTimer timer(counters.local().calculation_nanoseconds);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    auto statistics = counters.snapshot();
+    CHECK(statistics.hits == 4000);
+    CHECK(statistics.misses == 40);
+    CHECK(statistics.calculations == 0);
+    CHECK(statistics.calculation_seconds >= 0.004);
+    CHECK(statistics.database_seconds == 0);
+
+    counters.reset();
+    statistics = counters.snapshot();
+    CHECK(statistics.hits == 0);
+    CHECK(statistics.misses == 0);
+    CHECK(statistics.calculation_seconds == 0);
+}
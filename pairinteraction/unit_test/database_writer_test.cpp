@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabaseWriter.hpp"
+#include "SQLite.hpp"
+#include "filesystem.hpp"
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+struct F {
+    F() : path_cache(fs::create_temp_directory()) {}
+    ~F() { fs::remove_all(path_cache); }
+    fs::path path_cache;
+};
+
+TEST_CASE_FIXTURE(F, "database_writer_test") // NOLINT
+{
+    std::string dbname = (path_cache / "cache.db").string();
+    sqlite::handle db(dbname);
+    sqlite::statement stmt(db);
+    stmt.exec("PRAGMA journal_mode = WAL");
+    stmt.exec("create table cache_radial (method int, species text, k integer, n1 integer, l1 "
+              "integer, j1 double, n2 integer, l2 integer, j2 double, value double, primary key "
+              "(method, species, k, n1, l1, j1, n2, l2, j2)) without rowid;");
+
+    auto count = [&stmt]() {
+        stmt.set("select count(*), sum(value) from cache_radial;");
+        stmt.prepare();
+        stmt.step();
+        return std::make_pair(stmt.get<int>(0), stmt.get<double>(1));
+    };
+
+    {
+        DatabaseWriter writer(dbname);
+        writer.push({{0, "Rb", 1, 60, 0, 0.5, 60, 1, 0.5, 1.},
+                     {0, "Rb", 1, 60, 0, 0.5, 60, 1, 1.5, 2.}});
+        CHECK_NOTHROW(writer.flush());
+        CHECK(count() == std::make_pair(2, 3.));
+
+        // Existing rows are not overwritten, the remaining rows are written on destruction
+        writer.push({{0, "Rb", 1, 60, 0, 0.5, 60, 1, 0.5, 10.},
+                     {0, "Rb", 2, 60, 0, 0.5, 60, 2, 1.5, 4.}});
+    }
+    CHECK(count() == std::make_pair(3, 7.));
+
+    // Errors are reported by flush
+    DatabaseWriter writer((path_cache / "missing" / "cache.db").string());
+    writer.push({{0, "Rb", 1, 60, 0, 0.5, 60, 1, 0.5, 1.}});
+    CHECK_THROWS_AS(writer.flush(), sqlite::error);
+    CHECK_NOTHROW(writer.flush());
+}
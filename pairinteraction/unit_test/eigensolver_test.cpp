@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2018 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Eigensolver.hpp"
+#include "MatrixElementCache.hpp"
+#include "State.hpp"
+#include "SystemOne.hpp"
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <vector>
+
+namespace {
+// Sparse symmetric test matrix that consists of two identical tridiagonal blocks so that every
+// eigenvalue is twofold degenerate
+Eigen::SparseMatrix<double> buildTestMatrix(int size_block) {
+    std::vector<Eigen::Triplet<double>> triplets;
+    for (int offset = 0; offset < 2 * size_block; offset += size_block) {
+        for (int i = 0; i < size_block; ++i) {
+            triplets.emplace_back(offset + i, offset + i, std::sqrt(i + 1.));
+            if (i + 1 < size_block) {
+                triplets.emplace_back(offset + i, offset + i + 1, 0.1);
+                triplets.emplace_back(offset + i + 1, offset + i, 0.1);
+            }
+        }
+    }
+    Eigen::SparseMatrix<double> mat(2 * size_block, 2 * size_block);
+    mat.setFromTriplets(triplets.begin(), triplets.end());
+    return mat;
+}
+} // namespace
+
+TEST_CASE("shift_invert_lanczos_test") // NOLINT
+{
+    // The matrix is large enough that the Krylov subspace stays smaller than a quarter of it, the
+    // reference eigenvalues are obtained from one of the two identical blocks
+    Eigen::SparseMatrix<double> mat = buildTestMatrix(1000);
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> reference{
+        Eigen::MatrixXd(mat.topLeftCorner(1000, 1000)), Eigen::EigenvaluesOnly};
+
+    double energy_lower_bound = 5;
+    double energy_upper_bound = 6;
+
+    eigensolver::Eigenpairs<double> eigenpairs;
+    CHECK_NOTHROW(eigenpairs = eigensolver::shiftInvertLanczos(mat, energy_lower_bound,
+                                                               energy_upper_bound));
+
+    // Compare eigenvalues with the ones obtained by dense diagonalization
+    std::vector<double> evals_reference;
+    for (int i = 0; i < reference.eigenvalues().size(); ++i) {
+        double val = reference.eigenvalues()[i];
+        if (val >= energy_lower_bound && val <= energy_upper_bound) {
+            evals_reference.push_back(val);
+            evals_reference.push_back(val);
+        }
+    }
+    CHECK(eigenpairs.values.size() == static_cast<int>(evals_reference.size()));
+    for (size_t i = 0; i < evals_reference.size(); ++i) {
+        CHECK(eigenpairs.values[i] == doctest::Approx(evals_reference[i]).epsilon(1e-10));
+    }
+
+    // Check that the eigenvectors are orthonormal eigenvectors
+    Eigen::MatrixXd overlap = eigenpairs.vectors.adjoint() * eigenpairs.vectors;
+    CHECK(overlap.isIdentity(1e-10));
+    Eigen::MatrixXd residuals =
+        mat * eigenpairs.vectors - eigenpairs.vectors * eigenpairs.values.asDiagonal();
+    CHECK(residuals.norm() < 1e-8);
+}
+
+TEST_CASE("shift_invert_lanczos_empty_window_test") // NOLINT
+{
+    Eigen::SparseMatrix<double> mat = buildTestMatrix(50);
+
+    eigensolver::Eigenpairs<double> eigenpairs;
+    CHECK_NOTHROW(eigenpairs = eigensolver::shiftInvertLanczos(mat, 100, 200));
+    CHECK(eigenpairs.values.size() == 0);
+    CHECK(eigenpairs.vectors.cols() == 0);
+}
+
+TEST_CASE("shift_invert_lanczos_initial_subspace_test") // NOLINT
+{
+    // Matrices of two consecutive steps of a sweep
+    Eigen::SparseMatrix<double> mat_previous = buildTestMatrix(1000);
+    Eigen::SparseMatrix<double> mat = mat_previous * 1.001;
+
+    eigensolver::Eigenpairs<double> eigenpairs_previous =
+        eigensolver::shiftInvertLanczos(mat_previous, 5, 6);
+    eigensolver::Eigenpairs<double> eigenpairs_reference =
+        eigensolver::shiftInvertLanczos(mat, 5, 6);
+
+    // Use the eigenvectors of the previous step as the initial subspace
+    eigensolver::Eigenpairs<double> eigenpairs;
+    CHECK_NOTHROW(eigenpairs = eigensolver::shiftInvertLanczos(mat, 5, 6,
+                                                               eigenpairs_previous.vectors));
+    REQUIRE(eigenpairs.values.size() == eigenpairs_reference.values.size());
+    for (int i = 0; i < eigenpairs.values.size(); ++i) {
+        CHECK(eigenpairs.values[i] ==
+              doctest::Approx(eigenpairs_reference.values[i]).epsilon(1e-10));
+    }
+    Eigen::MatrixXd residuals =
+        mat * eigenpairs.vectors - eigenpairs.vectors * eigenpairs.values.asDiagonal();
+    CHECK(residuals.norm() < 1e-8);
+
+    // An initial subspace of the wrong size is rejected
+    CHECK_THROWS_AS(eigensolver::shiftInvertLanczos(mat, 5, 6, Eigen::MatrixXd(10, 2)),
+                    std::runtime_error);
+}
+
+TEST_CASE("shift_invert_lanczos_window_bounds_test") // NOLINT
+{
+    // A window whose bounds coincide with eigenvalues and a window whose eigenpairs would require
+    // a Krylov subspace larger than a quarter of the matrix
+    for (int size_block : {1000, 200}) {
+        Eigen::SparseMatrix<double> mat = buildTestMatrix(size_block);
+        Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> reference{
+            Eigen::MatrixXd(mat.topLeftCorner(size_block, size_block)), Eigen::EigenvaluesOnly};
+        std::vector<double> evals_all;
+        for (int i = 0; i < reference.eigenvalues().size(); ++i) {
+            evals_all.push_back(reference.eigenvalues()[i]);
+            evals_all.push_back(reference.eigenvalues()[i]);
+        }
+        auto window = size_block == 1000 ? std::make_pair(evals_all[50], evals_all[71])
+                                         : std::make_pair(1., 8.);
+
+        eigensolver::Eigenpairs<double> eigenpairs;
+        CHECK_NOTHROW(eigenpairs =
+                          eigensolver::shiftInvertLanczos(mat, window.first, window.second));
+
+        // Eigenvalues at the bounds of the window might or might not be found
+        std::vector<double> evals_reference;
+        for (double val : evals_all) {
+            if (val > window.first + 1e-8 && val < window.second - 1e-8) {
+                evals_reference.push_back(val);
+            }
+        }
+        std::vector<double> evals;
+        for (int i = 0; i < eigenpairs.values.size(); ++i) {
+            double val = eigenpairs.values[i];
+            CHECK(val >= window.first);
+            CHECK(val <= window.second);
+            if (val > window.first + 1e-8 && val < window.second - 1e-8) {
+                evals.push_back(val);
+            }
+        }
+        REQUIRE(evals.size() == evals_reference.size());
+        for (size_t i = 0; i < evals_reference.size(); ++i) {
+            CHECK(evals[i] == doctest::Approx(evals_reference[i]).epsilon(1e-10));
+        }
+        Eigen::MatrixXd residuals =
+            mat * eigenpairs.vectors - eigenpairs.vectors * eigenpairs.values.asDiagonal();
+        CHECK(residuals.norm() < 1e-8);
+    }
+}
+
+TEST_CASE("count_eigenvalues_below_test") // NOLINT
+{
+    // The diagonal entries of the matrix vanish after the shift so that the decomposition
+    // without pivoting runs into small pivots
+    Eigen::SparseMatrix<double> mat = buildTestMatrix(100);
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> reference{Eigen::MatrixXd(mat)};
+
+    for (double value : {0., 1., std::sqrt(2.), 5., 10., 20.}) {
+        int count_reference = 0;
+        for (int i = 0; i < reference.eigenvalues().size(); ++i) {
+            if (reference.eigenvalues()[i] < value) {
+                ++count_reference;
+            }
+        }
+        CHECK(eigensolver::countEigenvaluesBelow(mat, value) == count_reference);
+    }
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    for (int i = 0; i + 1 < 100; ++i) {
+        triplets.emplace_back(i, i + 1, 1);
+        triplets.emplace_back(i + 1, i, 1);
+    }
+    Eigen::SparseMatrix<double> mat_offdiagonal(100, 100);
+    mat_offdiagonal.setFromTriplets(triplets.begin(), triplets.end());
+    int count = eigensolver::countEigenvaluesBelow(mat_offdiagonal, 0);
+    CHECK((count == 50 || count == -1));
+
+    // If the number of eigenvalues cannot be counted, the dense matrix is diagonalized
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> reference_offdiagonal{
+        Eigen::MatrixXd(mat_offdiagonal)};
+    eigensolver::Eigenpairs<double> eigenpairs;
+    CHECK_NOTHROW(eigenpairs = eigensolver::shiftInvertLanczos(mat_offdiagonal, 0, 0.5));
+    REQUIRE(eigenpairs.values.size() == 8);
+    for (int i = 0; i < eigenpairs.values.size(); ++i) {
+        CHECK(eigenpairs.values[i] ==
+              doctest::Approx(reference_offdiagonal.eigenvalues()[50 + i]).epsilon(1e-10));
+    }
+}
+
+TEST_CASE("sweep_initial_subspace_test") // NOLINT
+{
+    // Step of a sweep of the electric field, the previous system is used for the initial subspace
+    // of the window, both if it has been diagonalized on the window and if it has not been
+    // diagonalized at all so that its basis vectors are the unperturbed states
+    MatrixElementCache cache;
+    StateOne state("Cs", 60, 0, 0.5, 0.5);
+    double energy_lower_bound = state.getEnergy() - 20;
+    double energy_upper_bound = state.getEnergy() + 20;
+
+    for (int delta_n : {1, 3}) {
+        for (bool diagonalize_previous : {true, false}) {
+            SystemOne system(state.getSpecies(), cache);
+            system.restrictEnergy(state.getEnergy() - 100, state.getEnergy() + 100);
+            system.restrictN(state.getN() - delta_n, state.getN() + delta_n);
+            system.restrictL(0, 1 + delta_n);
+            system.restrictM(0.5, 0.5);
+            system.setBfield({{0, 0, 50}});
+
+            SystemOne system_previous(system);
+            system_previous.setEfield({{0, 0, 1}});
+            if (diagonalize_previous) {
+                system_previous.diagonalize(energy_lower_bound, energy_upper_bound, 0);
+            }
+
+            system.setEfield({{0, 0, 1.01}});
+            SystemOne system_reference(system);
+            system_reference.diagonalize(energy_lower_bound, energy_upper_bound, 0);
+            system.diagonalize(energy_lower_bound, energy_upper_bound, 0, system_previous);
+
+            Eigen::VectorXd evals = Eigen::MatrixXd(system.getHamiltonian()).diagonal();
+            Eigen::VectorXd evals_reference =
+                Eigen::MatrixXd(system_reference.getHamiltonian()).diagonal();
+            REQUIRE(evals.size() == evals_reference.size());
+            REQUIRE(evals.size() > 0);
+            for (int i = 0; i < evals.size(); ++i) {
+                CHECK(evals[i] == doctest::Approx(evals_reference[i]).epsilon(1e-8));
+            }
+
+            Eigen::MatrixXd overlaps =
+                Eigen::MatrixXd(system_reference.getBasisvectors().adjoint() *
+                                system.getBasisvectors())
+                    .cwiseAbs2();
+            for (int i = 0; i < overlaps.rows(); ++i) {
+                CHECK(overlaps(i, i) == doctest::Approx(1).epsilon(1e-8));
+            }
+        }
+    }
+}
+
+TEST_CASE("bisection_test") // NOLINT
+{
+    Eigen::MatrixXd mat(buildTestMatrix(100));
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> reference(mat);
+
+    // Select the eigenpairs by their energy and by their index
+    eigensolver::Eigenpairs<double> eigenpairs_by_energy;
+    eigensolver::Eigenpairs<double> eigenpairs_by_index;
+    CHECK_NOTHROW(eigenpairs_by_energy = eigensolver::bisection(mat, 'V', 5, 6, 0, 0));
+    CHECK_NOTHROW(eigenpairs_by_index = eigensolver::bisection(mat, 'I', 0, 0, 10, 29));
+
+    for (const auto &eigenpairs : {eigenpairs_by_energy, eigenpairs_by_index}) {
+        REQUIRE(eigenpairs.values.size() > 0);
+
+        // Check that the eigenvectors are orthonormal eigenvectors, also within the degenerate
+        // subspaces
+        Eigen::MatrixXd overlap = eigenpairs.vectors.adjoint() * eigenpairs.vectors;
+        CHECK(overlap.isIdentity(1e-10));
+        Eigen::MatrixXd residuals =
+            mat * eigenpairs.vectors - eigenpairs.vectors * eigenpairs.values.asDiagonal();
+        CHECK(residuals.norm() < 1e-8);
+    }
+
+    // Compare eigenvalues with the ones obtained by the full diagonalization
+    std::vector<double> evals_reference;
+    for (int i = 0; i < reference.eigenvalues().size(); ++i) {
+        double val = reference.eigenvalues()[i];
+        if (val > 5 && val <= 6) {
+            evals_reference.push_back(val);
+        }
+    }
+    CHECK(eigenpairs_by_energy.values.size() == static_cast<int>(evals_reference.size()));
+    for (size_t i = 0; i < evals_reference.size(); ++i) {
+        CHECK(eigenpairs_by_energy.values[i] ==
+              doctest::Approx(evals_reference[i]).epsilon(1e-10));
+    }
+
+    CHECK(eigenpairs_by_index.values.size() == 20);
+    for (int i = 0; i < 20; ++i) {
+        CHECK(eigenpairs_by_index.values[i] ==
+              doctest::Approx(reference.eigenvalues()[10 + i]).epsilon(1e-10));
+    }
+}
+
+TEST_CASE("find_blocks_test") // NOLINT
+{
+    Eigen::SparseMatrix<double> mat = buildTestMatrix(3);
+    mat.coeffRef(1, 1) = 0;
+    mat.coeffRef(1, 2) = 0;
+    mat.coeffRef(2, 1) = 0;
+
+    std::vector<std::vector<int>> blocks = eigensolver::findBlocks(mat);
+    CHECK(blocks.size() == 3);
+    CHECK(blocks[0] == std::vector<int>({0, 1}));
+    CHECK(blocks[1] == std::vector<int>({2}));
+    CHECK(blocks[2] == std::vector<int>({3, 4, 5}));
+}
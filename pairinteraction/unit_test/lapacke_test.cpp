@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MatrixElementCache.hpp"
+#include "State.hpp"
+#include "SystemOne.hpp"
+#include "dtypes.hpp"
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <vector>
+
+#ifdef EIGEN_USE_LAPACKE
+namespace {
+std::vector<double> getEigenvalues(SystemOne &system) {
+    eigen_vector_t diagonal = system.getHamiltonian().diagonal();
+    std::vector<double> evals;
+    for (int i = 0; i < diagonal.size(); ++i) {
+        evals.push_back(std::real(diagonal[i]));
+    }
+    std::sort(evals.begin(), evals.end());
+    return evals;
+}
+} // namespace
+
+// The eigenpairs of an energy window are selected by counting the eigenvalues of the tridiagonal
+// matrix that is obtained by ?sytrd or ?hetrd, and are calculated by ?stemr
+TEST_CASE("lapacke_selection_test") // NOLINT
+{
+    MatrixElementCache cache;
+    StateOne state("Rb", 61, 2, 1.5, 1.5);
+
+    // Build a system whose Hamiltonian is a single block
+    SystemOne system(state.getSpecies(), cache);
+    system.restrictEnergy(state.getEnergy() - 40, state.getEnergy() + 40);
+    system.restrictN(state.getN() - 1, state.getN() + 1);
+    system.restrictL(state.getL() - 1, state.getL() + 1);
+    system.setEfield({{0, 0, 0.1}});
+    system.setBfield({{0.5, 0, 1}});
+    system.enableDiamagnetism(false);
+
+    SystemOne system_reference(system);
+    system_reference.diagonalize();
+    std::vector<double> evals_reference = getEigenvalues(system_reference);
+    const size_t n = evals_reference.size();
+    REQUIRE(n > 20);
+
+    // Select the eigenpairs by their energy, the bounds of the window lie between eigenvalues
+    size_t index_lower = n / 4;
+    size_t index_upper = 3 * n / 4;
+    SystemOne system_by_energy(system);
+    system_by_energy.diagonalizeRange(
+        0.5 * (evals_reference[index_lower - 1] + evals_reference[index_lower]),
+        0.5 * (evals_reference[index_upper] + evals_reference[index_upper + 1]));
+    std::vector<double> evals_by_energy = getEigenvalues(system_by_energy);
+    REQUIRE(evals_by_energy.size() == index_upper - index_lower + 1);
+    for (size_t i = 0; i < evals_by_energy.size(); ++i) {
+        CHECK(evals_by_energy[i] ==
+              doctest::Approx(evals_reference[index_lower + i]).epsilon(1e-10));
+    }
+
+    // Select the eigenpairs by their index
+    SystemOne system_by_index(system);
+    system_by_index.diagonalizeIndexRange(index_lower, index_upper);
+    std::vector<double> evals_by_index = getEigenvalues(system_by_index);
+    REQUIRE(evals_by_index.size() == index_upper - index_lower + 1);
+    for (size_t i = 0; i < evals_by_index.size(); ++i) {
+        CHECK(evals_by_index[i] ==
+              doctest::Approx(evals_reference[index_lower + i]).epsilon(1e-10));
+    }
+
+    // The basis vectors are orthonormal
+    for (auto *selected : {&system_by_energy, &system_by_index}) {
+        eigen_dense_t overlap = eigen_dense_t(selected->getBasisvectors().adjoint() *
+                                              selected->getBasisvectors());
+        CHECK(overlap.isIdentity(1e-10));
+    }
+}
+#endif // EIGEN_USE_LAPACKE
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2016 Sebastian Weber, Henri Menke. All rights reserved.
+ *
+ * This file is part of the pairinteraction library.
+ *
+ * The pairinteraction library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The pairinteraction library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MatrixElementCache.hpp"
+#include "MatrixElementStore.hpp"
+#include "State.hpp"
+#include "filesystem.hpp"
+#include "version.hpp"
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct F {
+    F() : path_cache(fs::create_temp_directory()) {}
+    ~F() { fs::remove_all(path_cache); }
+    fs::path path_cache;
+};
+
+TEST_CASE_FIXTURE(F, "matrix_element_store") // NOLINT
+{
+    std::string path = (path_cache / "store.bin").string();
+
+    auto key1 = MatrixElementStore::makeKey(NUMEROV, "Rb", 1, 60, 0, 0.5, 60, 1, 1.5);
+    auto key2 = MatrixElementStore::makeKey(NUMEROV, "Rb", 1, 60, 1, 1.5, 60, 0, 0.5);
+    auto key3 = MatrixElementStore::makeKey(WHITTAKER, "Rb", 1, 60, 0, 0.5, 60, 1, 1.5);
+    auto key4 = MatrixElementStore::makeKey(NUMEROV, "Cs", 1, 60, 0, 0.5, 60, 1, 1.5);
+
+    // Write elements in arbitrary order, the first occurrence of a duplicate is kept
+    MatrixElementStore::write(path, {{key2, 2.}, {key1, 1.}, {key3, 3.}, {key2, -2.}});
+
+    MatrixElementStore store(path);
+    CHECK(store.size() == 3);
+    CHECK(store.find(key1).value() == 1.);
+    CHECK(store.find(key2).value() == 2.);
+    CHECK(store.find(key3).value() == 3.);
+    CHECK(!store.find(key4).has_value());
+    CHECK(store.elements().size() == 3);
+
+    // Write another store while the first one is opened
+    std::string path_other = (path_cache / "store_other.bin").string();
+    MatrixElementStore::write(path_other, {{key4, 4.}});
+    CHECK(store.find(key1).value() == 1.);
+    CHECK(MatrixElementStore(path_other).find(key4).value() == 4.);
+
+    // Invalid files are rejected
+    std::string path_invalid = (path_cache / "invalid.bin").string();
+    {
+        std::ofstream ofs(path_invalid);
+        ofs << "This is not a matrix element store.";
+    }
+    CHECK_THROWS_AS(MatrixElementStore{path_invalid}, std::runtime_error);
+    CHECK_THROWS_AS(MatrixElementStore{(path_cache / "missing.bin").string()},
+                    std::runtime_error);
+    CHECK_THROWS_AS(MatrixElementStore::makeKey(NUMEROV, "ThisNameIsTooLong", 1, 60, 0, 0.5, 60,
+                                                1, 1.5),
+                    std::runtime_error);
+}
+
+TEST_CASE_FIXTURE(F, "matrix_element_cache_store") // NOLINT
+{
+    StateOne state1("Rb", 60, 0, 0.5, 0.5);
+    StateOne state2("Rb", 60, 1, 1.5, 0.5);
+
+    // Calculate a radial matrix element and export it
+    double value;
+    {
+        MatrixElementCache cache(path_cache.string());
+        value = cache.getRadial(state1, state2, 1);
+        cache.exportStore((path_cache / "store.bin").string());
+    }
+
+    // The store that the cache has opened from its directory can be replaced by an export
+    std::string path_default =
+        (path_cache / ("cache_elements_" + version::cache() + ".bin")).string();
+    {
+        MatrixElementCache cache(path_cache.string());
+        cache.exportStore(path_default);
+    }
+    {
+        MatrixElementCache cache(path_cache.string());
+        cache.getRadial(StateOne("Rb", 61, 0, 0.5, 0.5), state2, 1);
+        cache.exportStore(path_default);
+        CHECK(cache.getRadial(state1, state2, 1) == value);
+    }
+    CHECK(MatrixElementStore(path_default).size() == 2);
+
+    // The exported element is found in the store without calculating it again
+    fs::path path_other = fs::create_temp_directory();
+    {
+        MatrixElementCache cache(path_other.string());
+        cache.setStore((path_cache / "store.bin").string());
+        CHECK(cache.getRadial(state1, state2, 1) == value);
+    }
+
+    // Elements from the adaptive integration are not exported
+    {
+        MatrixElementCache cache(path_other.string());
+        cache.setRadialTolerance(1e-6);
+        CHECK(cache.getRadial(state1, state2, 1) != value);
+        cache.exportStore((path_other / "store_adaptive.bin").string());
+    }
+    CHECK(MatrixElementStore((path_other / "store_adaptive.bin").string()).size() == 0);
+    {
+        MatrixElementCache cache;
+        cache.setStore((path_other / "store_adaptive.bin").string());
+        CHECK(cache.getRadial(state1, state2, 1) == value);
+        CHECK(cache.getStatistics().radial.store_hits == 0);
+    }
+
+    // The store stays opened if an export fails
+    {
+        MatrixElementCache cache(path_other.string());
+        cache.setStore((path_cache / "store.bin").string());
+        CHECK_THROWS_AS(cache.exportStore((path_other / "missing" / "store.bin").string()),
+                        std::runtime_error);
+        CHECK(cache.getRadial(state1, state2, 1) == value);
+        CHECK(cache.getStatistics().radial.store_hits == 1);
+    }
+    fs::remove_all(path_other);
+}
+
+TEST_CASE_FIXTURE(F, "matrix_element_cache_memory_limit") // NOLINT
+{
+    std::vector<StateOne> states;
+    for (int n = 40; n < 50; ++n) {
+        states.emplace_back("Rb", n, 0, 0.5, 0.5);
+    }
+
+    MatrixElementCache cache_comparison;
+    std::vector<double> radials;
+    for (const auto &state : states) {
+        for (int kappa = 0; kappa < 10; ++kappa) {
+            radials.push_back(cache_comparison.getRadial(state, state, kappa));
+        }
+    }
+
+    // Elements are returned even if other threads evict them from a cache that is far too small
+    MatrixElementCache cache;
+    cache.setMemoryLimitRadial(1);
+    std::vector<std::thread> threads;
+    std::vector<std::vector<double>> radials_of_threads(4);
+    for (size_t i = 0; i < radials_of_threads.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            for (const auto &state : states) {
+                for (int kappa = 0; kappa < 10; ++kappa) {
+                    radials_of_threads[i].push_back(cache.getRadial(state, state, kappa));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const auto &radials_of_thread : radials_of_threads) {
+        CHECK(radials_of_thread == radials);
+    }
+}
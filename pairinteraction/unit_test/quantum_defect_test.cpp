@@ -17,13 +17,16 @@
  * along with the pairinteraction library. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "EmbeddedDatabase.hpp"
 #include "QuantumDefect.hpp"
 #include "SQLite.hpp"
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
+#include <cstdio>
+#include <fstream>
+#include <string>
+
 TEST_CASE("qd_test") // NOLINT
 {
     QuantumDefect qd("Rb", 45, 1, 0.5);
@@ -34,31 +37,75 @@ TEST_CASE("qd_test") // NOLINT
     CHECK(qd.l == 1);
     CHECK(qd.j == 0.5);
 
-    // Check whether values are correctly read from the db
-    EmbeddedDatabase db{};
+    // Check whether the values of the embedded tables agree with the database, which is created
+    // from the same SQL script
+    sqlite::handle db("pairinteraction/databases/quantum_defects.db");
     sqlite::statement stmt(db);
-    stmt.set("select ac,Z,a1,a2,a3,a4,rc from model_potential where ( (element "
-             "= 'Rb') and (L = 1) );");
-    // The database should be consistent
-    CHECK_NOTHROW(stmt.prepare());
-    CHECK_NOTHROW(stmt.step());
+    stmt.set("select element,L,ac,Z,a1,a2,a3,a4,rc from model_potential;");
+    stmt.prepare();
+    int rows = 0;
+    while (stmt.step()) {
+        // The largest j which is contained in the table of Rydberg-Ritz coefficients is used
+        QuantumDefect qd(stmt.get<std::string>(0), 50, stmt.get<int>(1), 100);
+        CHECK(qd.ac == stmt.get<double>(2));
+        CHECK(qd.Z == stmt.get<int>(3));
+        CHECK(qd.a1 == stmt.get<double>(4));
+        CHECK(qd.a2 == stmt.get<double>(5));
+        CHECK(qd.a3 == stmt.get<double>(6));
+        CHECK(qd.a4 == stmt.get<double>(7));
+        CHECK(qd.rc == stmt.get<double>(8));
+        ++rows;
+    }
+    CHECK(rows > 0);
+
+    stmt.reset();
+    stmt.set("select element,L,J,d0,d2,d4,d6,d8 from rydberg_ritz;");
+    stmt.prepare();
+    rows = 0;
+    while (stmt.step()) {
+        int n = 50;
+        int l = stmt.get<int>(1);
+        double d0 = stmt.get<double>(3);
+        double nstar = n -
+            (d0 + stmt.get<double>(4) / pow(n - d0, 2) + stmt.get<double>(5) / pow(n - d0, 4) +
+             stmt.get<double>(6) / pow(n - d0, 6) + stmt.get<double>(7) / pow(n - d0, 8));
+        QuantumDefect qd(stmt.get<std::string>(0), n, l, stmt.get<double>(2));
+        CHECK(qd.nstar == nstar);
+        ++rows;
+    }
+    CHECK(rows > 0);
+}
+
+TEST_CASE("qd_user_defined_database") // NOLINT
+{
+    std::string path = "quantum_defect_test.sql";
+    auto write = [&](std::string const &ac) {
+        std::ofstream ofs(path);
+        ofs << "CREATE TABLE `model_potential` ( `element` text,`L` int,`ac` real,`Z` int,`a1` "
+               "real,`a2` real,`a3` real,`a4` real,`rc` real);\n"
+               "INSERT INTO `model_potential` VALUES('Xx',0,'"
+            << ac
+            << "',3,'1','2','3','4','5');\n"
+               "CREATE TABLE `rydberg_ritz` ( `element` text,`L` int,`J` real,`d0` real,`d2` "
+               "real,`d4` real,`d6` real,`d8` real,`Ry` real);\n"
+               "INSERT INTO `rydberg_ritz` VALUES('Xx',0,'0.5','0.25','0','0','0','0',"
+               "'109737.31568525');\n";
+    };
+
+    write("0.5");
+    QuantumDefect qd("Xx", 40, 2, 2.5, path);
+    CHECK(qd.ac == 0.5);
+    CHECK(qd.Z == 3);
+    CHECK(qd.rc == 5);
+    CHECK(qd.nstar == 39.75);
+    CHECK_THROWS_AS(QuantumDefect("Xx", 40, 0, 0.5), std::exception);
 
-    // Check the retrieved values
-    double ac = stmt.get<double>(0);
-    int Z = stmt.get<double>(1);
-    double a1 = stmt.get<double>(2);
-    double a2 = stmt.get<double>(3);
-    double a3 = stmt.get<double>(4);
-    double a4 = stmt.get<double>(5);
-    double rc = stmt.get<double>(6);
+    // The database is loaded only once
+    write("1.5");
+    CHECK(QuantumDefect("Xx", 40, 0, 0.5, path).ac == 0.5);
+    std::remove(path.c_str());
 
-    CHECK(qd.ac == ac);
-    CHECK(qd.Z == Z);
-    CHECK(qd.a1 == a1);
-    CHECK(qd.a2 == a2);
-    CHECK(qd.a3 == a3);
-    CHECK(qd.a4 == a4);
-    CHECK(qd.rc == rc);
+    CHECK_THROWS_AS(QuantumDefect("Xx", 40, 0, 0.5, "does_not_exist.sql"), std::exception);
 }
 
 TEST_CASE("qd_errors") // NOLINT
@@ -24,7 +24,10 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
+#include <array>
+#include <deque>
 #include <iostream>
+#include <vector>
 
 template <int l>
 struct Fixture {
@@ -56,6 +59,29 @@ TEST_CASE_TEMPLATE("numerovs_method", T, Fixture<1>, Fixture<2>) // NOLINT
     CHECK(xy(xy.rows() - 1, 1) == doctest::Approx(0.0).epsilon(1e-6));
 }
 
+TEST_CASE_TEMPLATE("batched_radial_elements", T, Fixture<1>, Fixture<2>) // NOLINT
+{
+    T const fixture;
+    auto const qd = fixture.qd;
+    Numerov N(qd);
+    auto const &xy = N.integrate();
+
+    // All exponents are calculated in one sweep
+    auto const mu = IntegrateRadialElements<Numerov>(xy, {0, 1, 2}, xy);
+    REQUIRE(mu.size() == 3);
+
+    // The wavefunction is normalized
+    CHECK(mu[0] == doctest::Approx(1.0).epsilon(1e-6));
+
+    // The results agree with separate calculations
+    for (int power = 0; power < 3; ++power) {
+        CHECK(mu[power] ==
+              doctest::Approx(IntegrateRadialElement<Numerov>(qd, power, qd)).epsilon(1e-12));
+    }
+
+    CHECK_THROWS_AS(IntegrateRadialElements<Numerov>(xy, {2, 1}, xy), std::runtime_error);
+}
+
 #ifdef WITH_GSL
 TEST_CASE_TEMPLATE("coulomb_functions", T, Fixture<1>, Fixture<2>) // NOLINT
 {
@@ -99,3 +125,131 @@ TEST_CASE_TEMPLATE("integration", T, Fixture<1>, Fixture<2>) // NOLINT
     CHECK(mu_n == doctest::Approx(mu_w).scale(1e-3)); // corresponds to 0.1% deviation
 }
 #endif
+
+// Numerov's scheme for a single state, evaluating g three times per step
+eigen_dense_double_t integrate_reference(QuantumDefect const &qd) {
+    using model_potential::g;
+    eigen_dense_double_t xy = Numerov(qd).integrate();
+    int const nsteps = xy.rows();
+    double const dx = Numerov::dx;
+
+    xy.col(1).setZero();
+    xy(nsteps - 2, 1) = ((qd.n - qd.l) % 2 == 0) ? -1e-10 : 1e-10;
+    for (int i = nsteps - 3; i >= 0; --i) {
+        double A = (2. + 5. / 6. * dx * dx * g(qd, xy(i + 1, 0) * xy(i + 1, 0))) * xy(i + 1, 1);
+        double B = (1. - 1. / 12. * dx * dx * g(qd, xy(i + 2, 0) * xy(i + 2, 0))) * xy(i + 2, 1);
+        double C = 1. - 1. / 12. * dx * dx * g(qd, xy(i, 0) * xy(i, 0));
+        xy(i, 1) = (A - B) / C;
+    }
+
+    double norm = 0;
+    for (int i = 0; i < nsteps; ++i) {
+        norm += xy(i, 1) * xy(i, 1) * xy(i, 0) * xy(i, 0) * dx;
+    }
+    xy.col(1) /= std::sqrt(2 * norm);
+    return xy;
+}
+
+TEST_CASE("numerovs_method_batch") // NOLINT
+{
+    // States that share the model potential, with different numbers of steps
+    std::deque<QuantumDefect> qds;
+    for (int n : {79, 60, 75, 61, 90}) {
+        qds.emplace_back("Rb", n, 2, 1.5);
+    }
+    qds.emplace_back("Rb", 60, 2, 2.5);
+    std::vector<QuantumDefect const *> pointers;
+    for (auto const &qd : qds) {
+        pointers.push_back(&qd);
+    }
+
+    auto const batches = Numerov::makeBatches(pointers);
+    REQUIRE(batches.size() == 2);
+    CHECK(batches[0].size() == 5);
+    CHECK(batches[1].size() == 1);
+
+    // The results are identical to the ones of the integration of single states by the scalar
+    // scheme
+    auto const xys = Numerov::integrate(
+        {pointers[batches[0][0]], pointers[batches[0][1]], pointers[batches[0][2]],
+         pointers[batches[0][3]], pointers[batches[0][4]]});
+    REQUIRE(xys.size() == 5);
+    for (size_t idx = 0; idx < xys.size(); ++idx) {
+        auto const xy = integrate_reference(*pointers[batches[0][idx]]);
+        REQUIRE(xys[idx].rows() == xy.rows());
+        CHECK(xys[idx] == xy);
+    }
+
+    // States with different model potentials cannot be integrated together
+    CHECK_THROWS_AS(Numerov::integrate({pointers[0], pointers[5]}), std::runtime_error);
+}
+
+TEST_CASE("numerovs_method_stride") // NOLINT
+{
+    // The inner bounds of the states differ
+    QuantumDefect const qd1("Rb", 100, 0, 0.5);
+    QuantumDefect const qd2("Rb", 99, 6, 6.5);
+    auto const xy1 = Numerov(qd1).integrate();
+    auto const xy2 = Numerov(qd2).integrate();
+    REQUIRE(xy1(0, 0) != xy2(0, 0));
+    double const mu = IntegrateRadialElement<Numerov>(xy1, 1, xy2);
+
+    double mu_previous = 0;
+    for (int stride : {16, 8}) {
+        auto const xy1_coarse = Numerov(qd1, stride).integrate();
+        auto const xy2_coarse = Numerov(qd2, stride).integrate();
+        CHECK(xy1_coarse.rows() <= xy1.rows() / stride + 1);
+
+        // The coarse grids start below the inner bounds and are aligned
+        CHECK(xy1_coarse(0, 0) <= xy1(0, 0));
+        CHECK(xy2_coarse(0, 0) <= xy2(0, 0));
+        auto const mu_coarse = IntegrateRadialElements<Numerov>(xy1_coarse, {0, 1}, xy2_coarse,
+                                                                stride)[1];
+        CHECK(mu_coarse == doctest::Approx(mu).epsilon(1e-3));
+
+        // The error scales with the fourth power of the step
+        if (stride == 8) {
+            double const extrapolated = mu_coarse + (mu_coarse - mu_previous) / 15;
+            CHECK(std::abs(extrapolated - mu) < 1e-2 * std::abs(mu_coarse - mu));
+        }
+        mu_previous = mu_coarse;
+    }
+
+    CHECK_THROWS_AS(Numerov(qd1, 0), std::runtime_error);
+}
+
+TEST_CASE("semiclassical_method") // NOLINT
+{
+    // Neighboring states of high angular momentum
+    for (auto const &states : {std::array<int, 4>{{80, 6, 81, 7}},
+                               std::array<int, 4>{{80, 7, 79, 6}},
+                               std::array<int, 4>{{60, 5, 62, 6}}}) {
+        QuantumDefect const qd1("Rb", states[0], states[1], states[1] + 0.5);
+        QuantumDefect const qd2("Rb", states[2], states[3], states[3] + 0.5);
+        REQUIRE(semiclassical::IsValid(qd1, 1, qd2));
+        double const mu = IntegrateRadialElement<Numerov>(Numerov(qd1).integrate(), 1,
+                                                          Numerov(qd2).integrate());
+        CHECK(semiclassical::RadialDipoleElement(qd1, qd2) == doctest::Approx(mu).epsilon(1e-3));
+    }
+
+    // For vanishing quantum defects, the matrix element between states of the same n is the
+    // one of hydrogen, 3/2 n sqrt(n^2 - l_max^2)
+    QuantumDefect const qd1("Rb", 80, 10, 10.5);
+    QuantumDefect const qd2("Rb", 80, 11, 11.5);
+    REQUIRE(qd1.nstar == qd2.nstar);
+    CHECK(std::abs(semiclassical::RadialDipoleElement(qd1, qd2)) ==
+          doctest::Approx(1.5 * 80 * std::sqrt(80. * 80 - 11 * 11)));
+
+    // States that penetrate the core, other orders, and too large angular momenta
+    QuantumDefect const qd_s("Rb", 80, 0, 0.5);
+    QuantumDefect const qd_p("Rb", 80, 1, 1.5);
+    QuantumDefect const qd_d("Rb", 80, 2, 2.5);
+    QuantumDefect const qd_f("Rb", 80, 3, 3.5);
+    CHECK(!semiclassical::IsValid(qd_s, 1, qd_p));
+    CHECK(!semiclassical::IsValid(qd_d, 1, qd_f));
+    CHECK(!semiclassical::IsValid(qd1, 2, qd2));
+    CHECK(!semiclassical::IsValid(qd1, 1, qd1));
+    CHECK(!semiclassical::IsValid(QuantumDefect("Rb", 40, 9, 9.5), 1,
+                                  QuantumDefect("Rb", 40, 10, 10.5)));
+    CHECK_THROWS_AS(semiclassical::RadialDipoleElement(qd_s, qd_p), std::runtime_error);
+}
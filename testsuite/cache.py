@@ -1,3 +1,5 @@
+import shutil
+import tempfile
 import unittest
 
 from pairinteraction import pireal as pi
@@ -43,6 +45,103 @@ class CacheTest(unittest.TestCase):
         self.assertEqual(cache_numerov.size(), 10)
         self.assertEqual(cache_whittaker.size(), 10)
 
+    def test_radial_tolerance(self):
+        cache = pi.MatrixElementCache()
+        cache_adaptive = pi.MatrixElementCache()
+        cache_adaptive.setRadialTolerance(1e-6)
+
+        state_f = pi.StateOne("Rb", 100, 0, 1 / 2, 1 / 2)
+        state_i = pi.StateOne("Rb", 99, 1, 1 / 2, 1 / 2)
+        radial = cache.getRadial(state_f, state_i, 1)
+        radial_adaptive = cache_adaptive.getRadial(state_f, state_i, 1)
+        self.assertNotEqual(radial_adaptive, radial)
+        self.assertAlmostEqual(radial_adaptive, radial, delta=1e-6 * abs(radial))
+
+        # The wavefunctions have been integrated with several steps
+        self.assertGreater(cache_adaptive.getStatistics().wavefunction.calculations, 2)
+
+    def test_radial_semiclassical(self):
+        cache = pi.MatrixElementCache()
+        cache_semiclassical = pi.MatrixElementCache()
+        cache_semiclassical.setMethod(pi.SEMICLASSICAL)
+
+        # Dipole matrix elements between states of high angular momentum are approximated
+        state_f = pi.StateOne("Rb", 80, 6, 13 / 2, 1 / 2)
+        state_i = pi.StateOne("Rb", 81, 7, 15 / 2, 1 / 2)
+        radial = cache.getRadial(state_f, state_i, 1)
+        radial_semiclassical = cache_semiclassical.getRadial(state_f, state_i, 1)
+        self.assertAlmostEqual(radial_semiclassical, radial, delta=1e-3 * abs(radial))
+        self.assertEqual(cache_semiclassical.getStatistics().wavefunction.calculations, 0)
+
+        # The other matrix elements are calculated by Numerov's method
+        state_f = pi.StateOne("Rb", 80, 0, 1 / 2, 1 / 2)
+        state_i = pi.StateOne("Rb", 80, 1, 1 / 2, 1 / 2)
+        for kappa in range(3):
+            radial = cache.getRadial(state_f, state_i, kappa)
+            radial_semiclassical = cache_semiclassical.getRadial(state_f, state_i, kappa)
+            self.assertEqual(radial_semiclassical, radial)
+
+    def test_memory_limit(self):
+        cache = pi.MatrixElementCache()
+        cache.setMemoryLimitRadial(2000)
+
+        states = [pi.StateOne("Rb", n, 0, 1 / 2, 1 / 2) for n in range(40, 50)]
+        radials = [cache.getRadial(state, state, kappa) for state in states for kappa in range(10)]
+
+        usage = cache.getMemoryUsage()
+        self.assertEqual(usage.radial_limit, 2000)
+        self.assertLess(usage.radial_elements, len(radials))
+        self.assertEqual(cache.size(), usage.radial_elements)
+        self.assertGreater(usage.angular_bytes, 0)
+        self.assertGreaterEqual(usage.total_bytes, usage.radial_bytes + usage.angular_bytes)
+
+        # Evicted elements are calculated again
+        for i, state in enumerate(states):
+            for kappa in range(10):
+                self.assertEqual(cache.getRadial(state, state, kappa), radials[10 * i + kappa])
+
+    def test_warm(self):
+        cachedir = tempfile.mkdtemp()
+        try:
+            cache = pi.MatrixElementCache(cachedir)
+            num_missing = cache.warm("Rb", [40, 42], 2, [0, 1], pi.NUMEROV)
+            self.assertGreater(num_missing, 0)
+            self.assertEqual(cache.size(), num_missing)
+            self.assertEqual(cache.warm("Rb", [40, 42], 2, [0, 1], pi.NUMEROV), 0)
+
+            # The elements have been written to the database
+            cache_comparison = pi.MatrixElementCache(cachedir)
+            self.assertEqual(cache_comparison.warm("Rb", [40, 42], 2, [0, 1], pi.NUMEROV), num_missing)
+            state_f = pi.StateOne("Rb", 40, 0, 1 / 2, 1 / 2)
+            state_i = pi.StateOne("Rb", 42, 1, 3 / 2, 1 / 2)
+            self.assertEqual(cache_comparison.getRadial(state_f, state_i, 1), cache.getRadial(state_f, state_i, 1))
+            self.assertEqual(cache_comparison.size(), num_missing)
+        finally:
+            shutil.rmtree(cachedir)
+
+    def test_statistics(self):
+        cache = pi.MatrixElementCache()
+        state_f = pi.StateOne("Rb", 42, 0, 1 / 2, 1 / 2)
+        state_i = pi.StateOne("Rb", 42, 1, 1 / 2, 1 / 2)
+        dipole = cache.getElectricDipole(state_f, state_i)
+        self.assertEqual(cache.getElectricDipole(state_f, state_i), dipole)
+
+        statistics = cache.getStatistics()
+        self.assertEqual(statistics.radial.hits, 1)
+        self.assertEqual(statistics.radial.misses, 1)
+        self.assertEqual(statistics.radial.calculations, 1)
+        self.assertEqual(statistics.radial.store_hits + statistics.radial.database_hits, 0)
+        self.assertGreater(statistics.radial.calculation_seconds, 0)
+        self.assertEqual(statistics.wavefunction.calculations, 2)
+        self.assertEqual(statistics.angular.hits + statistics.angular.misses, 2)
+        self.assertEqual(statistics.angular.calculations, 1)
+
+        cache.resetStatistics()
+        statistics = cache.getStatistics()
+        self.assertEqual(statistics.radial.hits, 0)
+        self.assertEqual(statistics.angular.calculations, 0)
+        self.assertEqual(statistics.wavefunction.calculation_seconds, 0)
+
 
 if __name__ == "__main__":
     unittest.main()
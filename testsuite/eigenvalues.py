@@ -0,0 +1,66 @@
+import unittest
+
+import numpy as np
+
+from pairinteraction import pireal as pi
+
+
+class EigenvaluesTest(unittest.TestCase):
+    def setUp(self):
+        # Set up cache
+        self.cache = pi.MatrixElementCache()
+
+        # Setup states
+        state_one = pi.StateOne("Rb", 61, 2, 1.5, 1.5)
+        state_two = pi.StateTwo(state_one, state_one)
+
+        # Build one-atom system
+        system_one = pi.SystemOne(state_one.getSpecies(), self.cache)
+        system_one.restrictEnergy(state_one.getEnergy() - 40, state_one.getEnergy() + 40)
+        system_one.restrictN(state_one.getN() - 1, state_one.getN() + 1)
+        system_one.restrictL(state_one.getL() - 1, state_one.getL() + 1)
+
+        # Build two-atom system
+        self.system_two = pi.SystemTwo(system_one, system_one, self.cache)
+        self.system_two.restrictEnergy(state_two.getEnergy() - 5, state_two.getEnergy() + 5)
+        self.system_two.setDistance(6)
+
+    def test_eigenvalues_only(self):
+        # Calculate the eigenvalues without eigenvectors
+        evals = self.system_two.getEigenvalues()
+
+        # The system must not have been modified
+        self.assertEqual(self.system_two.getNumBasisvectors(), len(evals))
+        self.assertGreater(self.system_two.getHamiltonian().nnz, len(evals))
+
+        # Compare with the eigenvalues obtained by a full diagonalization
+        self.system_two.diagonalize()
+        evals_reference = self.system_two.getHamiltonian().diagonal()
+        np.testing.assert_allclose(evals, evals_reference, rtol=1e-10)
+
+    def test_diagonalize_range(self):
+        # Calculate all eigenvalues, the bounds of the energy window lie in gaps of the spectrum
+        evals_reference = self.system_two.getEigenvalues()
+        energy_lower_bound = (evals_reference[31] + evals_reference[32]) / 2
+        energy_upper_bound = (evals_reference[79] + evals_reference[80]) / 2
+
+        # Calculate only the eigenpairs within an energy window
+        system_two_range = pi.SystemTwo(self.system_two)
+        system_two_range.diagonalizeRange(energy_lower_bound, energy_upper_bound)
+        evals = system_two_range.getHamiltonian().diagonal()
+        np.testing.assert_allclose(evals, evals_reference[32:80], rtol=1e-10)
+
+        # Calculate only the eigenpairs within an index range
+        system_two_index_range = pi.SystemTwo(self.system_two)
+        system_two_index_range.diagonalizeIndexRange(32, 79)
+        evals = system_two_index_range.getHamiltonian().diagonal()
+        np.testing.assert_allclose(evals, evals_reference[32:80], rtol=1e-10)
+
+        # The basis vectors must be orthonormal
+        basisvectors = system_two_index_range.getBasisvectors()
+        overlap = (basisvectors.conj().T @ basisvectors).toarray()
+        np.testing.assert_allclose(overlap, np.eye(48), atol=1e-10)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -55,6 +55,16 @@ class RotationTest(unittest.TestCase):
             wignerd(1.5, 1.5, 0.5, np.pi / 2), -np.sqrt(3) * (1 + np.cos(np.pi / 2)) / 2 * np.sin(np.pi / 2 / 2)
         )
 
+    def test_rotation_WignerD_matrix(self):
+        wignerd = pi.WignerD()
+        j = 3.5
+        ms = np.arange(-j, j + 1)
+        for beta in [0.21, np.pi / 2, 3.23]:
+            matrix = np.array([[wignerd(j, m, mp, beta).real for mp in ms] for m in ms])
+            np.testing.assert_allclose(matrix @ matrix.T, np.eye(len(ms)), atol=1e-12)
+            self.assertAlmostEqual(matrix[-1, -1], np.cos(beta / 2) ** (2 * j))
+            self.assertAlmostEqual(matrix[-1, 0], (-np.sin(beta / 2)) ** (2 * j))
+
     def test_rotation_derotate(self):
         # Add interaction to the Hamiltonian and diagonalize it
         system_one_interacting = pi.SystemOne(self.system_one)